@@ -19,12 +19,15 @@
  */
 
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <random>
 #include <cmath>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 #include <marl-protocols/request-base.hpp>
 #include <marl-protocols/action-select-request.hpp>
 #include <marl-protocols/action-select-response.hpp>
@@ -33,6 +36,7 @@
 #include <flog/flog.hpp>
 #include "prettyprint.hpp"
 #include "agent.hpp"
+#include "kernels.hpp"
 
 #ifdef __DBL_DECIMAL_DIG__
 #define OP_DBL_DIGS (__DBL_DECIMAL_DIG__)
@@ -45,7 +49,28 @@
 #endif
 
 marl::agent::agent():
+    m_q_layout{q_layout_t::dense},
+    m_q_storage{q_storage_t::fp32},
+    m_storage_report{false},
+    m_seed{(static_cast<uint64_t>(std::random_device{}()) << 32) | std::random_device{}()},
+    m_exploit_temperature{0.0f},
+    m_publish_interval{0},
+    m_unpublished_steps{0},
+    m_kernels{&row_kernels_for(0)},
+    m_state_order{state_order_t::environment},
+    m_current{0},
+    m_start{0},
+    m_threads{1},
+    m_lockstep{1},
     m_request_sequence{0} {
+    m_exploration.strategy = exploration_t::softmax;
+    m_exploration.annealing = annealing_t::none;
+    m_exploration.sampler = softmax_sampler_t::inverse_cdf;
+    m_exploration.temperature = 50.0f;
+    m_exploration.min_temperature = 0.01f;
+    m_exploration.epsilon = 0.1f;
+    m_exploration.ucb_c = 1.41421356f;
+    m_exploration.episodes = 0;
 }
 
 marl::action_select_rsp marl::agent::process_request(const action_select_req& request) {
@@ -53,17 +78,27 @@ marl::action_select_rsp marl::agent::process_request(const action_select_req& re
     rsp.agent_id = m_id;
     rsp.request_number = request.request_number;
     rsp.requester_id = request.agent_id;
-    // Find what actions on requested state are present in current agents table
-    for(const q_entry_t& entry : m_q_table) {
-        if(entry.state == request.state_id) {
-            action_info i;
-            i.state = entry.state;
-            i.action = entry.action;
-            i.confidence = entry.confidence;
-            i.q_value = entry.value;
-            rsp.info.push_back(i);
+    // Find what actions on requested state are present in current agents table.
+    // Runs on the network thread, while the learner may be updating the table.
+    std::vector<q_entry_t> entries;
+    if(m_publish_interval == 0) {
+        m_q_table.read_row(request.state_id, entries);
+    } else {
+        // Keep the snapshot alive while copying, even if a newer one is published
+        std::shared_ptr<const q_snapshot> snapshot = m_publisher.current();
+        if(snapshot) {
+            snapshot->read_row(request.state_id, entries);
         }
     }
+    rsp.info.reserve(entries.size());
+    for(const q_entry_t& entry : entries) {
+        action_info i;
+        i.state = entry.state;
+        i.action = entry.action;
+        i.confidence = entry.confidence;
+        i.q_value = entry.value;
+        rsp.info.push_back(i);
+    }
     return rsp;
 }
 
@@ -91,13 +126,71 @@ void marl::agent::set_learning_rate(float r) {
 }
 
 void marl::agent::set_temperature(float f) {
-    m_temperature = f;
+    m_exploration.temperature = f;
 }
 
 void marl::agent::set_discount_factor(float d) {
     m_discount = d;
 }
 
+void marl::agent::set_q_layout(q_layout_t layout) {
+    m_q_layout = layout;
+}
+
+void marl::agent::set_q_storage(q_storage_t storage) {
+    m_q_storage = storage;
+}
+
+void marl::agent::set_storage_report(bool enabled) {
+    m_storage_report = enabled;
+}
+
+void marl::agent::set_publish_interval(uint32_t steps) {
+    m_publish_interval = steps;
+}
+
+void marl::agent::set_softmax_sampler(softmax_sampler_t sampler) {
+    m_exploration.sampler = sampler;
+}
+
+void marl::agent::set_exploration(exploration_t strategy) {
+    m_exploration.strategy = strategy;
+}
+
+void marl::agent::set_annealing(annealing_t annealing, float min_temperature) {
+    m_exploration.annealing = annealing;
+    m_exploration.min_temperature = min_temperature;
+}
+
+void marl::agent::set_epsilon(float epsilon) {
+    m_exploration.epsilon = epsilon;
+}
+
+void marl::agent::set_ucb_c(float c) {
+    m_exploration.ucb_c = c;
+}
+
+void marl::agent::set_seed(uint64_t seed) {
+    m_seed = seed;
+}
+
+void marl::agent::set_exploit_temperature(float t) {
+    m_exploit_temperature = t;
+}
+
+void marl::agent::set_state_order(state_order_t order) {
+    m_state_order = order;
+    m_ordered_states.clear();
+}
+
+void marl::agent::set_threads(uint32_t threads) {
+    m_threads = std::max(threads, 1u);
+}
+
+void marl::agent::set_lockstep(uint32_t episodes) {
+    m_lockstep = std::max(episodes, 1u);
+}
+
 void marl::agent::load_q_table() {
     std::ifstream file;
     file.open(m_q_file_path, std::ios_base::in);
@@ -107,10 +200,39 @@ void marl::agent::load_q_table() {
                m_q_file_path.c_str());
         return;
     }
+    m_q_table.initialize(ordered_states(), m_q_layout, m_q_storage);
+    // Sparse tables only get rows for states present in the file
+    std::unordered_map<uint32_t, const state*> states;
+    if(m_q_layout == q_layout_t::sparse) {
+        for(const state* s : m_env.states()) {
+            states.emplace(s->id(), s);
+        }
+    }
     q_entry_t e;
-    while(file >> e.state >> e.action
-            >> e.value >> e.confidence) {
-        m_q_table.push_back(e);
+    std::string line;
+    while(std::getline(file, line)) {
+        // Skip the header written by save_q_table()
+        if(line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        if(!(fields >> e.state >> e.action >> e.value >> e.confidence)) {
+            break;
+        }
+        uint32_t slot = m_q_table.find(e.state, e.action);
+        auto s = states.find(e.state);
+        if(slot == q_table::npos && s != states.end()) {
+            m_q_table.materialize(s->second);
+            slot = m_q_table.find(e.state, e.action);
+        }
+        if(slot == q_table::npos) {
+            flog::logger* l = flog::logger::instance();
+            l->log(flog::level_t::WARN, "Ignoring unknown Q-Table entry (%d, %d)",
+                   e.state, e.action);
+            continue;
+        }
+        const q_row row = m_q_table.row(e.state);
+        m_q_table.set_entry(row, slot - row.offset, e.value, e.confidence);
     }
     file.close();
 }
@@ -119,9 +241,23 @@ void marl::agent::print_q_table() {
     flog::logger* l = flog::logger::instance();
     l->log(flog::level_t::INFO, "Q Table is:");
     l->logc(flog::level_t::INFO, "#State\tAction\tValue\tConfidence\n");
-    for(const q_entry_t& e : m_q_table) {
-        l->logc(flog::level_t::INFO, "%d\t%d\t%f\t%f",
-                e.state, e.action, e.value, e.confidence);
+    // Rows are laid out in state order (-O) or visit order (sparse layout),
+    // the file lists them by state id whatever the layout
+    std::vector<size_t> order(m_q_table.rows());
+    for(size_t r = 0; r < order.size(); ++r) {
+        order[r] = r;
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return m_q_table.row_at(a).state < m_q_table.row_at(b).state;
+    });
+    for(size_t r : order) {
+        const q_row row = m_q_table.row_at(r);
+        for(size_t n = 0; n < row.size(); ++n) {
+            l->logc(flog::level_t::INFO, "%d\t%d\t%f\t%f",
+                    row.state, row.actions[n],
+                    m_q_table.value(row.offset + n),
+                    m_q_table.confidence(row.offset + n));
+        }
     }
 }
 
@@ -130,14 +266,38 @@ void marl::agent::save_q_table() {
     myfile.open(m_q_file_path, std::ios_base::out);
     myfile << "#State\tAction\tValue\tConfidence\n";
     myfile << std::setprecision(std::numeric_limits<double>::digits10 + 1) << std::fixed;
-    for(const q_entry_t& e : m_q_table) {
-        myfile << e.state << '\t' << e.action << '\t'
-               << e.value << '\t' << e.confidence << '\n';
+    // Rows are laid out in state order (-O) or visit order (sparse layout),
+    // the file lists them by state id whatever the layout
+    std::vector<size_t> order(m_q_table.rows());
+    for(size_t r = 0; r < order.size(); ++r) {
+        order[r] = r;
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return m_q_table.row_at(a).state < m_q_table.row_at(b).state;
+    });
+    for(size_t r : order) {
+        const q_row row = m_q_table.row_at(r);
+        for(size_t n = 0; n < row.size(); ++n) {
+            myfile << row.state << '\t' << row.actions[n] << '\t'
+                   << m_q_table.value(row.offset + n) << '\t'
+                   << m_q_table.confidence(row.offset + n) << '\n';
+        }
     }
     myfile.close();
 }
 
 void marl::agent::run() {
+    if(!m_mdp.compile(ordered_states())) {
+        flog::logger::instance()->log(flog::level_t::ERROR_,
+                                      "Environment has transitions to unknown states!");
+        terminate();
+        return;
+    }
+    if(m_start_index != -1) {
+        const state* start = m_env.states().at(m_start_index);
+        m_start = static_cast<uint32_t>(std::find(ordered_states().begin(), ordered_states().end(),
+                                                  start) - ordered_states().begin());
+    }
     switch(m_operation_mode) {
         case operation_mode_t::multi:
             run_multi();
@@ -148,6 +308,16 @@ void marl::agent::run() {
         default:
             break;
     }
+    if(m_storage_report) {
+        print_storage_report();
+    }
+    const arena_stats arena = get_arena_stats();
+    if(arena.mapped != 0) {
+        flog::logger* l = flog::logger::instance();
+        l->log(flog::level_t::INFO, "Arena: %zd bytes mapped, %zd huge page fallbacks, "
+               "%zd mappings not bound to a NUMA node", arena.mapped,
+               arena.huge_fallbacks, arena.numa_failures);
+    }
     terminate();
 }
 
@@ -171,30 +341,26 @@ void marl::agent::run_multi() {
     learn_multi();
 }
 
-void marl::agent::learn_single() {
+template<typename Exploration>
+void marl::agent::learn_single(Exploration& exploration) {
+    // Per-row state of the strategy for every row the table may get
+    exploration.reserve_rows(m_mdp.states(), m_mdp.action_count());
+    if(m_lockstep > 1) {
+        learn_lockstep(exploration);
+        return;
+    }
     flog::logger* l = flog::logger::instance();
-    // Initialize random engine
-    static std::random_device r;
-    static std::default_random_engine e1(r());
-    static std::uniform_int_distribution<int> uniform_dist(0, m_env.states().size() - 1);
-    // Initialize Q-Table
     for(const marl::action* a : m_env.actions()) {
-        q_entry_t e;
-        e.action = a->id();
-        e.state = a->from()->id();
-        e.confidence = 0;
-        e.value = 0.0;
-        m_q_table.push_back(e);
         for(transition* t : a->transitions()) {
-            l->log(flog::level_t::TRACE, "From %d to %d reward is: %f",
-                   a->from()->id(), t->to()->id(), t->reward());
+            l->log(flog::level_t::TRACE, "From %d to %d reward is: %f, probability is: %f",
+                   a->from()->id(), t->to()->id(), t->reward(), t->probability());
         }
     }
     // Initialize current state to a random number
     if(m_start_index == -1) {
-        m_current_state = m_env.states().at(uniform_dist(e1));
+        m_current = random_state();
     } else {
-        m_current_state = m_env.states().at(m_start_index);
+        m_current = m_start;
     }
     // Open Statistics File
     std::ofstream stat_file;
@@ -206,59 +372,60 @@ void marl::agent::learn_single() {
     while(episode < m_iterations) {
         l->log(flog::level_t::TRACE, "Running step: %d", step++);
         // Compute action probabilities
-        l->logc(flog::level_t::TRACE, "Current State: %d", m_current_state->id());
-        std::vector<float> m_qs;
-        for(const action* a : m_current_state->actions()) {
-            m_qs.push_back(q(m_current_state, a));
-        }
-        size_t selection = boltzmann_d(m_qs);
-        action* selected_action = m_current_state->actions().at(selection);
-        l->logc(flog::level_t::TRACE, "Selected Action: %d", selected_action->id());
-        // Perform the move
-        // TODO: Check for non-stattionary problems
-        state* old_state = m_current_state;
-        const transition* t = selected_action->transitions().at(0);
-        m_current_state = t->to();
-        float reward = t->reward();
-        l->logc(flog::level_t::TRACE, "Observed Reward: %f", reward);
+        l->logc(flog::level_t::TRACE, "Current State: %d", m_mdp.id(m_current));
+        // Only the first episode and steps growing the table may allocate
+        no_allocations guard(episode > 1);
+        const size_t rows = m_q_table.rows();
+        q_row row = state_row(m_current);
+        if(m_q_table.rows() != rows) {
+            guard.disarm();
+        }
+        const float* values = m_q_table.values(row, m_scratch.data());
+        size_t selection = exploration.select(row, values, m_engine);
         // Find entry to update
-        auto finder = [&selected_action, &old_state](const q_entry_t& e) {
-            return e.action == selected_action->id()
-                   && e.state == old_state->id();
-        };
-        // Update Q Table
-        auto item = std::find_if(m_q_table.begin(), m_q_table.end(),
-                                 finder);
-        if(item == m_q_table.end()) {
+        if(selection >= row.size()) {
             l->log(flog::level_t::ERROR_, "Invalid or incomplete Q-Table!");
             break;
         }
-        // calculate max_q for current state (which is after move)
-        float max_q = 0;
-        for(action* a : m_current_state->actions()) {
-            float new_max = q(m_current_state, a);
-            //l->logc(flog::level_t::TRACE, "New Max: %f", new_max);
-            max_q = (new_max > max_q) ? new_max : max_q;
+        exploration.update(row, selection);
+        const uint32_t selected_action = m_mdp.first_action(m_current) + selection;
+        l->logc(flog::level_t::TRACE, "Selected Action: %d", m_mdp.action_id(selected_action));
+        // Perform the move
+        const uint32_t t = m_mdp.sample_transition(selected_action, m_engine);
+        // An action without transitions is a dead end, nothing to bootstrap from
+        const bool dead_end = t == compiled_mdp::npos;
+        if(!dead_end) {
+            m_current = m_mdp.target(t);
         }
+        float reward = dead_end ? 0.0f : m_mdp.reward(t);
+        l->logc(flog::level_t::TRACE, "Observed Reward: %f", reward);
+        // calculate max_q for current state (which is after move)
+        float max_q = dead_end ? 0.0f :
+                      std::max(0.0f, m_q_table.row_max(m_q_table.row(m_mdp.id(m_current))));
         l->logc(flog::level_t::TRACE, "Maximum Q: %f", max_q);
-        item->value = (1.0f - m_learning_rate) * q(old_state, selected_action)
-                      + m_learning_rate * (reward + m_discount * max_q);
-        item->confidence += 0.001;
+        const uint32_t item = row.offset + selection;
+        m_q_table.set_entry(row, selection, (1.0f - m_learning_rate) * m_q_table.value(item)
+                            + m_learning_rate * (reward + m_discount * max_q),
+                            m_q_table.confidence(item) + 0.001f);
         l->logc(flog::level_t::TRACE, "Updated Q(%d, %d): %f",
-                m_current_state->id(), selected_action->id(), item->value);
+                m_mdp.id(m_current), m_mdp.action_id(selected_action), m_q_table.value(item));
         //print_q_table();
-        if(reward == 1.0) {
+        if(dead_end) {
+            l->log(flog::level_t::INFO, "Dead end. Trying a new state.");
+            m_current = random_state();
+        } else if(reward == 1.0) {
             l->log(flog::level_t::INFO, "Episode: %d Value: %d", episode, step);
             stat_file << std::setprecision(17);
             stat_file << std::setprecision(17) << std::fixed << episode << ' ' << step << '\n';
             if(episode % 100 == 0) {
                 stat_file.flush();
             }
+            exploration.end_episode(episode);
             episode++;
             step = 0;
             l->log(flog::level_t::INFO, "Goal reached. Trying a new state.");
-            m_current_state = m_env.states().at(uniform_dist(e1));
-            l->log(flog::level_t::INFO, "New state is: %d.", m_current_state->id());
+            m_current = random_state();
+            l->log(flog::level_t::INFO, "New state is: %d.", m_mdp.id(m_current));
             // print_q_table();
         }
     }
@@ -266,33 +433,106 @@ void marl::agent::learn_single() {
     save_q_table();
 }
 
-void marl::agent::learn_multi() {
+template<typename Exploration>
+void marl::agent::learn_lockstep(Exploration& exploration) {
+    flog::logger* l = flog::logger::instance();
+    const size_t count = m_lockstep;
+    m_lanes.resize(count);
+    exploration.reserve_batch(count);
+    for(size_t i = 0; i < count; ++i) {
+        m_lanes.current[i] = m_start_index == -1 ? random_state() : m_start;
+    }
+    // Open Statistics File
+    std::ofstream stat_file;
+    stat_file.open(m_stats_file_path, std::ios_base::out | std::ios_base::trunc);
+    stat_file << "#Episode Steps\n";
+    // Every pass selects, moves and updates once for each episode in flight
+    uint32_t episode = 1;
+    while(episode < m_iterations) {
+        // Only the first episode and steps growing the table may allocate
+        no_allocations guard(episode > 1);
+        const size_t rows = m_q_table.rows();
+        for(size_t i = 0; i < count; ++i) {
+            state_row(m_lanes.current[i]);
+            m_lanes.states[i] = m_mdp.id(m_lanes.current[i]);
+        }
+        if(m_q_table.rows() != rows) {
+            guard.disarm();
+        }
+        exploration.select_batch(m_q_table, m_lanes.states.data(), count,
+                                 m_lanes.actions.data(), m_engine);
+        if(std::find(m_lanes.actions.begin(), m_lanes.actions.end(), q_table::npos)
+                != m_lanes.actions.end()) {
+            l->log(flog::level_t::ERROR_, "Invalid or incomplete Q-Table!");
+            break;
+        }
+        for(size_t i = 0; i < count; ++i) {
+            const uint32_t t = m_mdp.sample_transition(m_mdp.first_action(m_lanes.current[i])
+                                                       + m_lanes.actions[i], m_engine);
+            // Dead ends keep npos as their target
+            m_lanes.targets[i] = t == compiled_mdp::npos ? t : m_mdp.target(t);
+            m_lanes.rewards[i] = t == compiled_mdp::npos ? 0.0f : m_mdp.reward(t);
+        }
+        // Targets are computed from the table before any update of the pass
+        for(size_t i = 0; i < count; ++i) {
+            if(m_lanes.targets[i] == compiled_mdp::npos) {
+                m_lanes.max_q[i] = 0.0f;
+                continue;
+            }
+            const q_row target = m_q_table.row(m_mdp.id(m_lanes.targets[i]));
+            m_lanes.max_q[i] = std::max(0.0f, m_q_table.row_max(target));
+        }
+        for(size_t i = 0; i < count; ++i) {
+            const q_row row = m_q_table.row(m_lanes.states[i]);
+            const uint32_t n = m_lanes.actions[i];
+            exploration.update(row, n);
+            const uint32_t item = row.offset + n;
+            m_q_table.set_entry(row, n, (1.0f - m_learning_rate) * m_q_table.value(item)
+                                + m_learning_rate * (m_lanes.rewards[i]
+                                                     + m_discount * m_lanes.max_q[i]),
+                                m_q_table.confidence(item) + 0.001f);
+        }
+        for(size_t i = 0; i < count; ++i) {
+            m_lanes.steps[i]++;
+            if(m_lanes.targets[i] == compiled_mdp::npos) {
+                m_lanes.current[i] = random_state();
+                continue;
+            }
+            m_lanes.current[i] = m_lanes.targets[i];
+            if(m_lanes.rewards[i] != 1.0f || episode >= m_iterations) {
+                continue;
+            }
+            l->log(flog::level_t::INFO, "Episode: %d Value: %d", episode, m_lanes.steps[i]);
+            stat_file << episode << ' ' << m_lanes.steps[i] << '\n';
+            if(episode % 100 == 0) {
+                stat_file.flush();
+            }
+            exploration.end_episode(episode);
+            episode++;
+            m_lanes.steps[i] = 0;
+            m_lanes.current[i] = random_state();
+        }
+    }
+    stat_file.close();
+    save_q_table();
+}
+
+template<typename Exploration>
+void marl::agent::learn_multi(Exploration& exploration) {
     flog::logger* l = flog::logger::instance();
-    // Initialize random engine
-    static std::random_device r;
-    static std::default_random_engine e1(r());
-    static std::uniform_int_distribution<int> uniform_dist(0, m_env.states().size() - 1);
+    exploration.reserve_rows(m_mdp.states(), m_mdp.action_count());
     // Initialize visits
     m_visits.clear();
     for(const marl::state* s : m_env.states()) {
         m_visits.emplace(s->id(), 0);
     }
-    // Initialize Q-Table
-    for(const marl::action* a : m_env.actions()) {
-        q_entry_t e;
-        e.action = a->id();
-        e.state = a->from()->id();
-        e.confidence = 0.0;
-        e.value = 0;
-        m_q_table.push_back(e);
-    }
     // Initialize current state to a random number
     if(m_start_index == -1) {
-        m_current_state = m_env.states().at(uniform_dist(e1));
+        m_current = random_state();
     } else {
-        m_current_state = m_env.states().at(m_start_index);
+        m_current = m_start;
     }
-    l->log(flog::level_t::INFO, "Starting at state: %d", m_current_state->id());
+    l->log(flog::level_t::INFO, "Starting at state: %d", m_mdp.id(m_current));
     // Run algorithm
     uint32_t episode = 1;
     uint32_t step = 0;
@@ -307,9 +547,9 @@ void marl::agent::learn_multi() {
         // Ask other agents
         action_select_req r;
         r.agent_id = m_id;
-        r.confidence = m_visits.at(m_current_state->id());
+        r.confidence = m_visits.at(m_mdp.id(m_current));
         r.request_number = (++m_request_sequence);
-        r.state_id = m_current_state->id();
+        r.state_id = m_mdp.id(m_current);
 
         this->set_rendezvous(r.request_number);
         send_message(r);
@@ -341,88 +581,73 @@ void marl::agent::learn_multi() {
                         reply.action, reply.confidence, reply.q_value, reply.state);
             }
         }
-        for(const action* a : m_current_state->actions()) {
-            action_info i;
-            i.action = a->id();
-            i.state = m_current_state->id();
-            i.q_value = q(m_current_state->id(), a->id());
-            i.confidence = c(m_current_state, a);
-            response->info.push_back(i);
+        // Messaging allocates, the rest of the step only during the first
+        // episode and when growing the table
+        no_allocations guard(episode > 1);
+        // Rows are created on first visit on sparse layout
+        const size_t rows = m_q_table.rows();
+        const q_row row = state_row(m_current);
+        if(m_q_table.rows() != rows) {
+            guard.disarm();
         }
-        // perform action based on the reply
-        std::vector<action_info> concensus = aggregate_and_normalize(response->info);
-        // Update Q-Table based on new information
-        for(q_entry_t& e: m_q_table) {
-            for(action_info& a: concensus) {
-                if(e.action == a.action) {
-                    e.value = a.q_value;
-                    break;
-                }
-            }
-        }
-
-        std::vector<float> m_qs;
-        for(const action_info a : concensus) {
-            m_qs.push_back(a.q_value);
-        }
-        size_t selection = boltzmann_d(m_qs);
-        //        l->log(flog::level_t::INFO, "Boltzman: %zd of %zd",
-        //               selection, concensus.size());
-        uint32_t action_id = concensus.at(selection).action;
-        action* selected_action = nullptr;
-        for(action* a  : m_current_state->actions()) {
-            if(a->id() == action_id) {
-                selected_action = a;
-                break;
-            }
-        }
-        if(!selected_action) {
-            // TODO check for error source,
-            continue;
+        if(m_mdp.actions(m_current) == 0) {
+            l->log(flog::level_t::ERROR_, "State %d has no actions!", m_mdp.id(m_current));
+            break;
         }
-        // perform actual action
-        l->logc(flog::level_t::TRACE, "Selected Action: %d", selected_action->id());
-        state* old_state = m_current_state;
-        const transition* t = selected_action->transitions().at(0);
-        m_current_state = t->to();
-        float reward = t->reward();
-        l->logc(flog::level_t::TRACE, "Observed Reward: %f", reward);
-        // Find entry to update
-        auto finder = [&selected_action, &old_state](const q_entry_t& e) {
-            return e.action == selected_action->id()
-                   && e.state == old_state->id();
-        };
-        // Update Q Table
-        auto item = std::find_if(m_q_table.begin(), m_q_table.end(),
-                                 finder);
-        if(item == m_q_table.end()) {
+        // perform action based on the reply
+        aggregate_and_normalize(response->info, row);
+        // Update Q-Table based on new information, which is about this state
+        // only. Other states may have actions with the same ids.
+        m_q_table.set_values(row, m_qs.data());
+        // Select among the actions of this state, valued by the consensus.
+        // Actions known to other agents only can not be performed here.
+        const size_t n = exploration.select(row, m_qs.data(), m_engine);
+        if(n >= row.size()) {
             l->log(flog::level_t::ERROR_, "Invalid or incomplete Q-Table!");
             break;
         }
-        // calculate max_q for current state (which is after move)
-        float max_q = 0;
-        for(action* a : m_current_state->actions()) {
-            float new_max = q(m_current_state, a);
-            l->logc(flog::level_t::TRACE, "New Max: %f", new_max);
-            max_q = (new_max > max_q) ? new_max : max_q;
+        exploration.update(row, n);
+        const uint32_t selected_action = m_mdp.first_action(m_current) + n;
+        // perform actual action
+        l->logc(flog::level_t::TRACE, "Selected Action: %d", m_mdp.action_id(selected_action));
+        const uint32_t t = m_mdp.sample_transition(selected_action, m_engine);
+        // Dead ends restart as in learn_single()
+        const bool dead_end = t == compiled_mdp::npos;
+        if(!dead_end) {
+            m_current = m_mdp.target(t);
         }
+        float reward = dead_end ? 0.0f : m_mdp.reward(t);
+        l->logc(flog::level_t::TRACE, "Observed Reward: %f", reward);
+        // calculate max_q for current state (which is after move)
+        float max_q = dead_end ? 0.0f :
+                      std::max(0.0f, m_q_table.row_max(m_q_table.row(m_mdp.id(m_current))));
         //        l->logc(flog::level_t::TRACE, "Maximum Q: %f", max_q);
-        item->value = (1.0f - m_learning_rate) * q(old_state, selected_action)
-                      + m_learning_rate * (reward + m_discount * max_q);
-        item->confidence += 0.1;
+        // Slot of the performed action, the row was materialized above
+        const uint32_t item = static_cast<uint32_t>(row.offset + n);
+        m_q_table.set_entry(row, n,
+                            (1.0f - m_learning_rate) * m_q_table.value(item)
+                            + m_learning_rate * (reward + m_discount * max_q),
+                            m_q_table.confidence(item) + 0.1f);
         l->logc(flog::level_t::TRACE, "Updated Q(%d, %d): %f",
-                m_current_state->id(), selected_action->id(), item->value);
-        if(reward == 1.0) {
+                m_mdp.id(m_current), m_mdp.action_id(selected_action), m_q_table.value(item));
+        if(publish_step()) {
+            guard.disarm();
+        }
+        if(dead_end) {
+            l->log(flog::level_t::INFO, "Dead end. Trying a new state.");
+            m_current = random_state();
+        } else if(reward == 1.0) {
             l->log(flog::level_t::INFO, "Episode: %d Value: %d", episode, step);
             stat_file << episode << ' ' << step << '\n';
             if(episode % 100 == 0) {
                 stat_file.flush();
             }
+            exploration.end_episode(episode);
             episode++;
             step = 0;
             l->log(flog::level_t::INFO, "Goal reached. Trying a new state.");
-            m_current_state = m_env.states().at(uniform_dist(e1));
-            l->log(flog::level_t::INFO, "New state is: %d.", m_current_state->id());
+            m_current = random_state();
+            l->log(flog::level_t::INFO, "New state is: %d.", m_mdp.id(m_current));
             // print_q_table();
         }
     }
@@ -430,160 +655,380 @@ void marl::agent::learn_multi() {
     save_q_table();
 }
 
-void marl::agent::exploit() {
-
+void marl::agent::learn_single() {
+    if(m_threads > 1) {
+        learn_threads();
+        return;
+    }
+    m_q_table.initialize(ordered_states(), m_q_layout, m_q_storage);
+    allocate_scratch();
+    // Peers only read the table in multi-agent mode
+    m_q_table.set_concurrent(false);
+    seed_engine();
+    m_exploration.episodes = m_iterations;
+    switch(m_exploration.strategy) {
+        case exploration_t::softmax: {
+            softmax_exploration exploration(m_exploration, m_scratch.size());
+            learn_single(exploration);
+            break;
+        }
+        case exploration_t::epsilon_greedy: {
+            epsilon_greedy_exploration exploration(m_exploration, m_scratch.size());
+            learn_single(exploration);
+            break;
+        }
+        case exploration_t::ucb1: {
+            ucb1_exploration exploration(m_exploration, m_scratch.size());
+            learn_single(exploration);
+            break;
+        }
+    }
 }
 
-float marl::agent::c(const marl::state* s, const marl::action* a) const {
-    flog::logger* l = flog::logger::instance();
-    if(!s || !a) {
-        l->log(flog::level_t::ERROR_, "Invalid state or action pointer!");
-        return 0.0;
-    }
-    // Validate if action actually belongs to this state
-    auto finder = [&](action * aa)->bool {
-        return aa->id() == a->id();
-    };
-    bool found = std::any_of(s->actions().cbegin(),
-                             s->actions().cend(), finder);
-    if(!found) {
-        l->log(flog::level_t::ERROR_, "Action can not be initiated from state!");
-        return 0;
+void marl::agent::learn_multi() {
+    m_q_table.initialize(ordered_states(), m_q_layout, m_q_storage);
+    allocate_scratch();
+    start_publishing();
+    seed_engine();
+    m_exploration.episodes = m_iterations;
+    switch(m_exploration.strategy) {
+        case exploration_t::softmax: {
+            softmax_exploration exploration(m_exploration, m_scratch.size());
+            learn_multi(exploration);
+            break;
+        }
+        case exploration_t::epsilon_greedy: {
+            epsilon_greedy_exploration exploration(m_exploration, m_scratch.size());
+            learn_multi(exploration);
+            break;
+        }
+        case exploration_t::ucb1: {
+            ucb1_exploration exploration(m_exploration, m_scratch.size());
+            learn_multi(exploration);
+            break;
+        }
     }
-    // Find confidence and return it.
-    for(const q_entry_t& qe : m_q_table) {
-        if(qe.state == s->id() && qe.action == a->id()) {
-            return qe.confidence;
+}
+
+template<typename Exploration>
+void marl::agent::learn_worker(Exploration& exploration, worker& w) {
+    exploration.reserve_rows(m_mdp.states(), m_mdp.action_count());
+    uint32_t episode = 1;
+    uint32_t step = 0;
+    while(episode <= w.episodes && m_is_running.load(std::memory_order_relaxed)) {
+        // Only the first episode may allocate, the table does not grow
+        no_allocations guard(episode > 1);
+        step++;
+        const q_row& row = m_hogwild.row(w.current);
+        m_hogwild.values(row, w.values.data());
+        const size_t selection = exploration.select(row, w.values.data(), w.engine);
+        if(selection >= row.size()) {
+            break;
+        }
+        exploration.update(row, selection);
+        const uint32_t t = m_mdp.sample_transition(m_mdp.first_action(w.current) + selection,
+                                                   w.engine);
+        // Dead ends restart as in learn_single()
+        const bool dead_end = t == compiled_mdp::npos;
+        if(!dead_end) {
+            w.current = m_mdp.target(t);
+        }
+        const float reward = dead_end ? 0.0f : m_mdp.reward(t);
+        const float max_q = dead_end ? 0.0f :
+                            std::max(0.0f, m_hogwild.row_max(m_hogwild.row(w.current),
+                                                             w.values.data()));
+        const uint32_t item = row.offset + selection;
+        m_hogwild.set_entry(item, (1.0f - m_learning_rate) * m_hogwild.value(item)
+                            + m_learning_rate * (reward + m_discount * max_q),
+                            m_hogwild.confidence(item) + 0.001f);
+        if(dead_end) {
+            w.current = static_cast<uint32_t>(uniform_index(w.engine, m_mdp.states()));
+        } else if(reward == 1.0) {
+            w.episode_steps.push_back(step);
+            exploration.end_episode(episode);
+            episode++;
+            w.steps += step;
+            step = 0;
+            w.current = static_cast<uint32_t>(uniform_index(w.engine, m_mdp.states()));
         }
     }
-    l->log(flog::level_t::ERROR_, "Can not find Q-Value for %d and %d!",
-           s->id(), a->id());
-    return 0;
+    w.steps += step;
 }
 
-float marl::agent::q(const state* s, const marl::action* a) const {
+template<typename Exploration>
+void marl::agent::learn_threads(const Exploration& exploration) {
     flog::logger* l = flog::logger::instance();
-    if(!s || !a) {
-        l->log(flog::level_t::ERROR_, "Invalid state or action pointer!");
-        return 0.0;
+    // Split the episodes learn_single() would run, the first workers taking
+    // one more if they do not divide evenly
+    const uint32_t episodes = m_iterations > 1 ? m_iterations - 1 : 0;
+    std::vector<worker> workers(m_threads);
+    for(uint32_t k = 0; k < m_threads; ++k) {
+        worker& w = workers[k];
+        // Every worker draws from its own part of this agent's stream
+        w.engine = m_engine;
+        for(uint32_t j = 0; j <= k; ++j) {
+            w.engine.long_jump();
+        }
+        w.current = m_start_index == -1 ?
+                    static_cast<uint32_t>(uniform_index(w.engine, m_mdp.states())) : m_start;
+        w.episodes = episodes / m_threads + (k < episodes % m_threads ? 1 : 0);
+        w.steps = 0;
+        w.episode_steps.reserve(w.episodes);
+        w.values.resize(m_scratch.size());
+    }
+    const auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(m_threads);
+    for(uint32_t k = 0; k < m_threads; ++k) {
+        threads.emplace_back([this, &exploration, &workers, k]() {
+            // State of the strategy, e.g. the visit counts of UCB1, is per
+            // thread. Sharing it would add a contended write to every step.
+            Exploration own(exploration);
+            learn_worker(own, workers[k]);
+        });
+    }
+    for(std::thread& t : threads) {
+        t.join();
     }
-    // Validate if action actually belongs to this state
-    auto finder = [&](action * aa)->bool {
-        return aa->id() == a->id();
-    };
-    bool found = std::any_of(s->actions().cbegin(),
-                             s->actions().cend(), finder);
-    if(!found) {
-        l->log(flog::level_t::ERROR_, "Action can not be initiated from state!");
-        return 0;
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - begin).count();
+    uint64_t steps = 0;
+    for(const worker& w : workers) {
+        steps += w.steps;
     }
-    // Find Q-Value and return it.
-    for(const q_entry_t& qe : m_q_table) {
-        if(qe.state == s->id() && qe.action == a->id()) {
-            return qe.value;
+    l->log(flog::level_t::INFO, "%d threads learned %d episodes in %llu steps, %f steps/s",
+           m_threads, episodes, static_cast<unsigned long long>(steps),
+           seconds > 0.0 ? steps / seconds : 0.0);
+    // Episodes are listed round-robin over the workers, as they ran side by side
+    std::ofstream stat_file;
+    stat_file.open(m_stats_file_path, std::ios_base::out | std::ios_base::trunc);
+    stat_file << "#Episode Steps\n";
+    size_t rounds = 0;
+    for(const worker& w : workers) {
+        rounds = std::max(rounds, w.episode_steps.size());
+    }
+    uint32_t episode = 1;
+    for(size_t j = 0; j < rounds; ++j) {
+        for(const worker& w : workers) {
+            if(j < w.episode_steps.size()) {
+                stat_file << episode++ << ' ' << w.episode_steps[j] << '\n';
+            }
         }
     }
-    l->log(flog::level_t::ERROR_, "Can not find Q-Value for %d and %d!",
-           s->id(), a->id());
-    return q(s->id(), a->id());
+    stat_file.close();
+    m_hogwild.store(m_q_table);
+    m_hogwild.clear();
+    save_q_table();
 }
 
-float marl::agent::q(uint32_t s, uint32_t a) const {
-    flog::logger* l = flog::logger::instance();
-    // Find Q-Value and return it.
-    for(const q_entry_t& qe : m_q_table) {
-        if(qe.state == s && qe.action == a) {
-            return qe.value;
+void marl::agent::learn_threads() {
+    m_q_table.initialize(ordered_states(), m_q_layout, m_q_storage);
+    allocate_scratch();
+    m_q_table.set_concurrent(false);
+    seed_engine();
+    m_hogwild.load(m_q_table, m_mdp);
+    flog::logger::instance()->log(flog::level_t::INFO,
+                                  "Learning on %d threads sharing %zd bytes of Q-Table",
+                                  m_threads, m_hogwild.bytes());
+    // Every worker anneals over its own share of the episodes
+    m_exploration.episodes = (m_iterations + m_threads - 1) / m_threads;
+    switch(m_exploration.strategy) {
+        case exploration_t::softmax: {
+            softmax_exploration exploration(m_exploration, m_scratch.size());
+            learn_threads(exploration);
+            break;
+        }
+        case exploration_t::epsilon_greedy: {
+            epsilon_greedy_exploration exploration(m_exploration, m_scratch.size());
+            learn_threads(exploration);
+            break;
+        }
+        case exploration_t::ucb1: {
+            ucb1_exploration exploration(m_exploration, m_scratch.size());
+            learn_threads(exploration);
+            break;
         }
     }
-    l->log(flog::level_t::ERROR_,
-           "Can not find Q-Value for (%d, %d)...", s, a);
-    return 0;
 }
 
-size_t marl::agent::boltzmann_d(const std::vector<float>& values) const {
-    static std::random_device rd;
-    static std::mt19937 e2(rd());
-    static std::uniform_real_distribution<> dist(0, 1);
-
+void marl::agent::exploit() {
     flog::logger* l = flog::logger::instance();
-
-    std::vector<float> probabilites;
-    float total = 0.0;
-    for(float value : values) {
-        total += exp(value / m_temperature);
-    }
-    for(float value : values) {
-        const float p = exp(value / m_temperature) / total;
-        probabilites.push_back(p);
-    }
-    float rand = dist(e2);
-    l->log(flog::level_t::TRACE, "Input size: %zd", values.size());
-    l->logc(flog::level_t::TRACE, "Random seed: %f", rand);
-    float max_p = 0;
-    size_t selected = 0;
-
-    for(float value : probabilites) {
-        max_p += value;
-        l->logc(flog::level_t::TRACE, "Value= %f, Max(P)=%f", value, max_p);
-        if(rand <= max_p) {
+    seed_engine();
+    // The table is not modified any more, draw actions from precomputed tables
+    m_policy.freeze(m_q_table, m_exploit_temperature);
+    l->log(flog::level_t::INFO, "Froze policy at temperature %f, %zd bytes",
+           m_exploit_temperature, m_policy.bytes());
+    // Initialize current state to a random number
+    if(m_start_index == -1) {
+        m_current = random_state();
+    } else {
+        m_current = m_start;
+    }
+    // Open Statistics File
+    std::ofstream stat_file;
+    stat_file.open(m_stats_file_path, std::ios_base::out | std::ios_base::trunc);
+    stat_file << "#Episode Steps\n";
+    // A greedy policy may loop forever, give up on an episode after visiting
+    // as many states as the problem has.
+    const uint32_t max_steps = static_cast<uint32_t>(m_env.states().size());
+    uint32_t episode = 1;
+    uint32_t step = 0;
+    while(m_is_running.load() && episode < m_iterations) {
+        step++;
+        if(m_mdp.actions(m_current) == 0) {
+            l->log(flog::level_t::ERROR_, "State %d has no actions!", m_mdp.id(m_current));
             break;
-        } else {
-            selected++;
+        }
+        uint32_t selection = m_policy.select(m_mdp.id(m_current), m_engine);
+        if(selection == q_table::npos) {
+            // Not in the loaded table, nothing is known about the state
+            selection = static_cast<uint32_t>(
+                uniform_index(m_engine, m_mdp.actions(m_current)));
+        }
+        const uint32_t selected_action = m_mdp.first_action(m_current) + selection;
+        l->logc(flog::level_t::TRACE, "Selected Action: %d", m_mdp.action_id(selected_action));
+        const uint32_t t = m_mdp.sample_transition(selected_action, m_engine);
+        // A dead end ends the episode like running out of steps
+        const bool dead_end = t == compiled_mdp::npos;
+        if(!dead_end) {
+            m_current = m_mdp.target(t);
+        }
+        float reward = dead_end ? 0.0f : m_mdp.reward(t);
+        if(reward == 1.0 || step >= max_steps || dead_end) {
+            l->log(flog::level_t::INFO, "Episode: %d Value: %d", episode, step);
+            stat_file << episode << ' ' << step << '\n';
+            if(episode % 100 == 0) {
+                stat_file.flush();
+            }
+            episode++;
+            step = 0;
+            m_current = random_state();
         }
     }
-    if(selected >= values.size()) {
-        selected = values.size() - 1;
+    stat_file.close();
+}
+
+void marl::agent::start_publishing() {
+    m_publisher.reset();
+    m_unpublished_steps = 0;
+    m_q_table.set_concurrent(m_publish_interval == 0);
+    if(m_publish_interval != 0) {
+        m_publisher.publish(m_q_table);
     }
-    /*
-    std::stringstream ss;
-    ss << values;
-    l->logc(flog::level_t::INFO, "   input: %s", ss.str().c_str());
-    ss.str("");
-    ss << probabilites;
-    l->logc(flog::level_t::INFO, "P vector: %s", ss.str().c_str());
-    ss.str("");
-    l->logc(flog::level_t::INFO, "Selected: %zd", selected);
-    l->logc(flog::level_t::INFO, "Selected: (%f)", values.at(selected));
-    */
-    return selected;
 }
 
+bool marl::agent::publish_step() {
+    if(m_publish_interval == 0 || ++m_unpublished_steps < m_publish_interval) {
+        return false;
+    }
+    m_publisher.publish(m_q_table);
+    m_unpublished_steps = 0;
+    return true;
+}
 
-std::vector<marl::action_info> marl::agent::aggregate_and_normalize(const std::vector<marl::action_info>& v) {
-    std::vector<marl::action_info> r;
-    for(const action_info& i : v) {
-        auto finder =
-        [&i](const action_info & item) -> bool {
-            return item.action == i.action;
-        };
-        auto found = std::find_if(r.begin(), r.end(), finder);
-        if(found == r.end()) {
-            action_info first = i;
-            first.q_value = first.confidence * first.q_value;
-            r.push_back(first);
-        } else {
-            found->q_value += i.confidence * i.q_value;
-            found->confidence += i.confidence;
-        }
+void marl::agent::seed_engine() {
+    m_engine.seed(m_seed, m_id);
+}
+
+const std::vector<marl::state*>& marl::agent::ordered_states() {
+    if(m_ordered_states.size() != m_env.states().size()) {
+        m_ordered_states = order_states(m_env.states(), m_state_order);
     }
-    // TODO: remove actions which are not accepted in current state
-    // add self-opinion on the consensus
-    for(action* a : m_current_state->actions()) {
-        for(action_info& ai : r) {
-            if(ai.action == a->id()) {
-                ai.confidence += c(m_current_state, a) ;
-                ai.q_value += c(m_current_state, a) * q(m_current_state, a);
-            }
+    return m_ordered_states;
+}
+
+uint32_t marl::agent::random_state() {
+    return static_cast<uint32_t>(uniform_index(m_engine, m_mdp.states()));
+}
+
+marl::q_row marl::agent::state_row(uint32_t s) {
+    const q_row row = m_q_table.row(m_mdp.id(s));
+    return row.index != q_table::npos ? row : m_q_table.materialize(m_mdp.state_at(s));
+}
+
+void marl::agent::lanes::resize(size_t count) {
+    current.assign(count, 0);
+    states.assign(count, 0);
+    actions.assign(count, 0);
+    targets.assign(count, 0);
+    rewards.assign(count, 0.0f);
+    max_q.assign(count, 0.0f);
+    steps.assign(count, 0);
+}
+
+void marl::agent::allocate_scratch() {
+    size_t width = 0;
+    for(const state* s : m_env.states()) {
+        width = std::max(width, s->actions().size());
+    }
+    m_scratch.resize(width);
+    m_qs.resize(width);
+    m_consensus_c.resize(width);
+    m_confidences.resize(width);
+    m_kernels = &row_kernels_for(width);
+    flog::logger::instance()->log(flog::level_t::INFO,
+                                  "Widest row has %zd actions, unrolled kernels: %zd",
+                                  width, row_kernels_for(width).width);
+}
+
+void marl::agent::print_storage_report() const {
+    static const char* names[] = {"fp32", "fp16", "bf16", "int8"};
+    static const q_storage_t storages[] = {q_storage_t::fp32, q_storage_t::fp16,
+                                           q_storage_t::bf16, q_storage_t::int8
+                                          };
+    flog::logger* l = flog::logger::instance();
+    l->log(flog::level_t::INFO, "Q-Table storage report (%zd entries, %zd bytes in use, "
+           "errors against the %s table):", m_q_table.size(), m_q_table.bytes(),
+           names[static_cast<size_t>(m_q_table.storage())]);
+    l->logc(flog::level_t::INFO, "Storage\tBytes\tMax Error\tMean Error\t"
+            "Max Confidence Error\tMean Confidence Error\tGreedy Agreement");
+    for(size_t i = 0; i < sizeof(storages) / sizeof(storages[0]); ++i) {
+        const q_storage_stats stats = m_q_table.evaluate(storages[i]);
+        l->logc(flog::level_t::INFO, "%s\t%zd\t%g\t%g\t%g\t%g\t%.2f%%",
+                names[i], stats.bytes, stats.max_error, stats.mean_error,
+                stats.max_confidence_error, stats.mean_confidence_error,
+                stats.agreement * 100.0f);
+    }
+}
+
+size_t marl::agent::position(const q_row& row, uint32_t action, size_t hint) const {
+    if(hint < row.size() && row.actions[hint] == action) {
+        return hint;
+    }
+    if(m_q_layout == q_layout_t::sparse) {
+        const uint32_t slot = m_q_table.find(row.state, action);
+        return slot == q_table::npos ? row.size() : slot - row.offset;
+    }
+    return std::find(row.actions, row.actions + row.size(), action) - row.actions;
+}
+
+void marl::agent::aggregate_and_normalize(const std::vector<marl::action_info>& v,
+                                          const q_row& row) {
+    float* q = m_qs.data();
+    float* c = m_consensus_c.data();
+    std::fill(q, q + row.size(), 0.0f);
+    std::fill(c, c + row.size(), 0.0f);
+    // Peers reply with rows in the same order, so the next action is usually
+    // the one after the last match, or the first one of the row
+    size_t hint = 0;
+    for(const action_info& i : v) {
+        const size_t p = position(row, i.action, hint);
+        if(p == row.size()) {
+            // Not an action of this state
+            continue;
         }
+        q[p] += i.confidence * i.q_value;
+        c[p] += i.confidence;
+        hint = p + 1 < row.size() ? p + 1 : 0;
     }
+    // This agent's entries count as a reply, and once more as its
+    // self-opinion on the consensus
+    const float* values = m_q_table.values(row, m_scratch.data());
+    const float* confidences = m_q_table.confidences(row, m_confidences.data());
+    m_kernels->weighted_sum(q, c, values, confidences, row.size());
+    m_kernels->weighted_sum(q, c, values, confidences, row.size());
     // normalize
-    for(action_info& ai : r) {
-        if(ai.confidence != 0.0) {
-            ai.q_value = ai.q_value / ai.confidence;
-        } else {
-            ai.q_value = 0.0;
-        }
+    for(size_t n = 0; n < row.size(); ++n) {
+        q[n] = c[n] != 0.0f ? q[n] / c[n] : 0.0f;
     }
-    return r;
 }
@@ -19,7 +19,15 @@
 */
 
 #include <marl-protocols/client-base.hpp>
+#include "allocation-count.hpp"
+#include "compiled-mdp.hpp"
+#include "exploration.hpp"
+#include "frozen-policy.hpp"
+#include "hogwild-table.hpp"
 #include "q-table.hpp"
+#include "q-snapshot.hpp"
+#include "random.hpp"
+#include "state-order.hpp"
 #include <marl-protocols/state.hpp>
 
 namespace marl {
@@ -40,32 +48,138 @@ public:
     void set_learning_rate(float);
     void set_temperature(float);
     void set_discount_factor(float);
+    void set_q_layout(q_layout_t);
+    void set_q_storage(q_storage_t);
+    // Log how accurate and how large the Q-Table would be on each storage
+    void set_storage_report(bool);
+    // Serve peers from a snapshot of the Q-Table republished every N learning
+    // steps, or from the live table if N is zero. Only multi-agent mode has
+    // peers.
+    void set_publish_interval(uint32_t);
+    void set_softmax_sampler(softmax_sampler_t);
+    void set_exploration(exploration_t);
+    // Anneal the softmax temperature down to min_temperature over all episodes
+    void set_annealing(annealing_t, float min_temperature);
+    void set_epsilon(float);
+    void set_ucb_c(float);
+    // Makes runs reproducible, agents sharing a seed still draw independently
+    void set_seed(uint64_t);
+    // Exploit by sampling the Boltzmann policy of the loaded table at this
+    // temperature, or greedily if it is zero
+    void set_exploit_temperature(float);
+    // Lays out states for locality, before the Q-Table is loaded
+    void set_state_order(state_order_t);
+    // Learns in single-agent mode on this many threads sharing the Q-Table,
+    // splitting the episodes among them
+    void set_threads(uint32_t);
+    // Learns in single-agent mode on this many episodes advanced in lockstep
+    void set_lockstep(uint32_t);
 protected:
     void print_q_table();
+    void print_storage_report() const;
     void run() override;
     void run_single();
     void run_multi();
+    // Instantiate the learning loop on the selected exploration strategy
     void learn_single();
     void learn_multi();
+    template<typename Exploration>
+    void learn_single(Exploration& exploration);
+    template<typename Exploration>
+    void learn_multi(Exploration& exploration);
+    void learn_threads();
+    template<typename Exploration>
+    void learn_threads(const Exploration& exploration);
+    template<typename Exploration>
+    void learn_lockstep(Exploration& exploration);
     void exploit();
-    // Helper functions
-    float c(const state* s, const action* a) const;
-    float q(const state* s, const action* a) const;
-    float q(uint32_t s, uint32_t a) const;
-    // Boltzmann distribution function for softmax selection
-    size_t boltzmann_d(const std::vector<float> &values) const;
 private:
-    std::vector<action_info> aggregate_and_normalize(const std::vector<action_info>& v);
+    // Episodes, random stream and current state of a learning thread
+    struct worker {
+        xoshiro256 engine;
+        uint32_t current;
+        uint32_t episodes;
+        uint64_t steps;
+        // Steps of each finished episode
+        std::vector<uint32_t> episode_steps;
+        std::vector<float> values;
+    };
+
+    // Episodes of learn_lockstep() as a structure of arrays, one entry each
+    struct lanes {
+        std::vector<uint32_t> current;      // index in m_mdp
+        std::vector<uint32_t> states;       // id of the current state
+        std::vector<uint32_t> actions;      // position in the row
+        std::vector<uint32_t> targets;      // index in m_mdp after the move, or npos
+        std::vector<float> rewards;
+        std::vector<float> max_q;           // of the target's row
+        std::vector<uint32_t> steps;
+
+        void resize(size_t count);
+    };
+
+    template<typename Exploration>
+    void learn_worker(Exploration& exploration, worker& w);
+    void allocate_scratch();
+    // Restarts the engine at the stream of this agent
+    void seed_engine();
+    // Index of a uniformly drawn state of m_mdp
+    uint32_t random_state();
+    // Row of a state of m_mdp, materialized if missing
+    q_row state_row(uint32_t s);
+    // States of the environment in the order of m_state_order, computed once
+    const std::vector<state*>& ordered_states();
+    // Decides how peers read the freshly initialized table, multi-agent only
+    void start_publishing();
+    // Counts a learning step, publishing a snapshot when the interval is over.
+    // Returns true if it did, which may allocate.
+    bool publish_step();
+    // Confidence-weighted consensus on the actions of a row from the replies
+    // and this agent's entries, written to m_qs
+    void aggregate_and_normalize(const std::vector<action_info>& v, const q_row& row);
+    // Position of an action in a row, or row.size(), trying hint first
+    size_t position(const q_row& row, uint32_t action, size_t hint) const;
 
     std::string m_q_file_path;
     std::string m_stats_file_path;
-    std::vector<q_entry_t> m_q_table;
+    q_table m_q_table;
+    q_layout_t m_q_layout;
+    q_storage_t m_q_storage;
+    bool m_storage_report;
+    exploration_config m_exploration;
+    // Seeds the engine of this agent, its stream is the agent id. Without a
+    // seed runs are seeded randomly.
+    uint64_t m_seed;
+    xoshiro256 m_engine;
+    float m_exploit_temperature;
+    frozen_policy m_policy;
+    q_publisher m_publisher;
+    uint32_t m_publish_interval;
+    uint32_t m_unpublished_steps;
+    // Decoded values of one row, as wide as the widest row
+    std::vector<float> m_scratch;
+    // Per-step buffers of learn_multi(), reused so steady-state steps do not
+    // allocate. Consensus values and confidences by position in the row.
+    std::vector<float> m_qs;
+    std::vector<float> m_consensus_c;
+    std::vector<float> m_confidences;
+    const row_kernels* m_kernels;
     state_stats_t m_visits;
     float m_ask_treshold;
     float m_discount;           // gamma
     float m_learning_rate;      // alpha
-    float m_temperature;        // tau
-    marl::state* m_current_state;
+    state_order_t m_state_order;
+    std::vector<state*> m_ordered_states;
+    // Environment as flat arrays, compiled when the agent starts
+    compiled_mdp m_mdp;
+    // Index of the current state, and of the start state, in m_mdp
+    uint32_t m_current;
+    uint32_t m_start;
+    uint32_t m_threads;
+    // Q-Table shared by the learning threads
+    hogwild_table m_hogwild;
+    uint32_t m_lockstep;
+    lanes m_lanes;
     uint32_t m_request_sequence;
 };
 }
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "alias-table.hpp"
+#include <cmath>
+
+marl::alias_table::alias_table() {
+    m_offsets.push_back(0);
+}
+
+void marl::alias_table::clear() {
+    m_offsets.resize(1);
+    m_probability.clear();
+    m_alias.clear();
+}
+
+uint32_t marl::alias_table::add(const float* weights, size_t n) {
+    const uint32_t first = m_offsets.back();
+    m_probability.resize(first + n);
+    m_alias.resize(first + n);
+    m_scaled.resize(n);
+    m_small.clear();
+    m_large.clear();
+    double total = 0.0;
+    for(size_t i = 0; i < n; ++i) {
+        total += weights[i];
+    }
+    // Scale weights to a mean of one, so columns above it donate to those below
+    const bool uniform = !(total > 0.0) || !std::isfinite(total);
+    const double scale = uniform ? 0.0 : static_cast<double>(n) / total;
+    for(size_t i = 0; i < n; ++i) {
+        m_scaled[i] = uniform ? 1.0f : static_cast<float>(weights[i] * scale);
+        if(m_scaled[i] < 1.0f) {
+            m_small.push_back(static_cast<uint32_t>(i));
+        } else {
+            m_large.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    while(!m_small.empty() && !m_large.empty()) {
+        const uint32_t s = m_small.back();
+        const uint32_t l = m_large.back();
+        m_small.pop_back();
+        m_probability[first + s] = m_scaled[s];
+        m_alias[first + s] = l;
+        m_scaled[l] -= 1.0f - m_scaled[s];
+        if(m_scaled[l] < 1.0f) {
+            m_large.pop_back();
+            m_small.push_back(l);
+        }
+    }
+    // Whatever is left is one up to rounding
+    for(uint32_t i : m_large) {
+        m_probability[first + i] = 1.0f;
+        m_alias[first + i] = i;
+    }
+    for(uint32_t i : m_small) {
+        m_probability[first + i] = 1.0f;
+        m_alias[first + i] = i;
+    }
+    m_offsets.push_back(first + static_cast<uint32_t>(n));
+    return static_cast<uint32_t>(m_offsets.size() - 2);
+}
+
+size_t marl::alias_table::bytes() const {
+    return m_offsets.size() * sizeof(uint32_t)
+           + m_probability.size() * sizeof(float)
+           + m_alias.size() * sizeof(uint32_t);
+}
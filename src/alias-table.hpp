@@ -0,0 +1,78 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_ALIAS_TABLE_HPP
+#define MARL_ALIAS_TABLE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "arena.hpp"
+
+namespace marl {
+
+/*
+ * Walker alias tables of a set of discrete distributions, packed one after
+ * another. Each distribution is added once from its weights, in O(n), and
+ * is then sampled in O(1) from two uniform numbers: one picks a column, the
+ * other chooses between the column and its alias.
+ */
+class alias_table {
+public:
+    alias_table();
+    void clear();
+    // Appends the distribution proportional to n non-negative weights and
+    // returns its index. Weights summing to zero, or not to a finite value,
+    // give the uniform distribution.
+    uint32_t add(const float* weights, size_t n);
+    // Number of outcomes of a distribution
+    size_t size(uint32_t distribution) const {
+        return m_offsets[distribution + 1] - m_offsets[distribution];
+    }
+    size_t distributions() const {
+        return m_offsets.size() - 1;
+    }
+    // Outcome of a distribution, given two uniform numbers in [0, 1)
+    uint32_t sample(uint32_t distribution, float u, float v) const {
+        const uint32_t first = m_offsets[distribution];
+        const uint32_t n = m_offsets[distribution + 1] - first;
+        uint32_t column = static_cast<uint32_t>(u * static_cast<float>(n));
+        if(column >= n) {
+            column = n - 1;
+        }
+        return v < m_probability[first + column] ? column : m_alias[first + column];
+    }
+    // Memory used by the tables, in bytes
+    size_t bytes() const;
+private:
+    // distribution -> first column, has one extra element marking the end
+    arena_vector<uint32_t> m_offsets;
+    // Chance of keeping a column rather than taking its alias
+    arena_vector<float> m_probability;
+    arena_vector<uint32_t> m_alias;
+    // Work lists of add()
+    std::vector<float> m_scaled;
+    std::vector<uint32_t> m_small;
+    std::vector<uint32_t> m_large;
+};
+
+}
+
+#endif // MARL_ALIAS_TABLE_HPP
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_ALLOCATION_COUNT_HPP
+#define MARL_ALLOCATION_COUNT_HPP
+
+#include <cassert>
+#include <cstdint>
+
+namespace marl {
+
+#ifdef MARL_COUNT_ALLOCATIONS
+// Calls to operator new made by the calling thread so far. Built with
+// -DMARL_COUNT_ALLOCATIONS only, which replaces the global operator new.
+uint64_t thread_allocations();
+// Counts an allocation made without operator new, e.g. by the arena
+void count_allocation();
+#endif
+
+/*
+ * Asserts that the scope it guards makes no heap allocation on the calling
+ * thread, e.g. a learning step past warm-up. Without MARL_COUNT_ALLOCATIONS,
+ * or built with NDEBUG, it does nothing. `make check' runs the learning step
+ * under it in tests/allocation-guard.
+ */
+class no_allocations {
+public:
+#ifdef MARL_COUNT_ALLOCATIONS
+    explicit no_allocations(bool armed):
+        m_armed{armed},
+        m_start{thread_allocations()} {
+    }
+    ~no_allocations() {
+        assert(!m_armed || thread_allocations() == m_start);
+    }
+    // For steps expected to allocate, e.g. materializing a new row
+    void disarm() {
+        m_armed = false;
+    }
+private:
+    bool m_armed;
+    uint64_t m_start;
+#else
+    explicit no_allocations(bool) {
+    }
+    void disarm() {
+    }
+#endif
+};
+
+}
+
+#endif // MARL_ALLOCATION_COUNT_HPP
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "arena.hpp"
+#include "allocation-count.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// Placed in front of every block, tells how to release it
+struct alignas(64) block_header {
+    size_t length;      // of the mapping, zero for heap blocks
+};
+
+const size_t huge_page_size = 2 << 20;
+// Not every libc exposes the mempolicy constants, see set_mempolicy(2)
+const int mpol_preferred = 1;
+
+std::atomic<int> g_pages{static_cast<int>(marl::huge_pages_t::none)};
+std::atomic<bool> g_numa_local{false};
+std::atomic<size_t> g_mapped{0};
+std::atomic<size_t> g_huge_fallbacks{0};
+std::atomic<size_t> g_numa_failures{0};
+
+bool bind_to_local_node(void* p, size_t length) {
+#if defined(SYS_getcpu) && defined(SYS_mbind)
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if(syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+        return false;
+    }
+    const size_t bits = 8 * sizeof(unsigned long);
+    unsigned long mask[1024 / bits] = {};
+    if(node >= 1024) {
+        return false;
+    }
+    mask[node / bits] = 1UL << (node % bits);
+    // Preferred rather than strict binding, so a full node spills over
+    return syscall(SYS_mbind, p, length, mpol_preferred, mask, 1024UL, 0) == 0;
+#else
+    (void)p;
+    (void)length;
+    return false;
+#endif
+}
+
+void* map(size_t& length) {
+    const marl::huge_pages_t pages = static_cast<marl::huge_pages_t>(g_pages.load());
+    void* p = MAP_FAILED;
+    if(pages != marl::huge_pages_t::none) {
+        length = (length + huge_page_size - 1) / huge_page_size * huge_page_size;
+    }
+#ifdef MAP_HUGETLB
+    if(pages == marl::huge_pages_t::hugetlb) {
+        p = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(p == MAP_FAILED) {
+            g_huge_fallbacks++;
+        }
+    }
+#endif
+    if(p == MAP_FAILED) {
+        p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED) {
+            return nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        if(pages != marl::huge_pages_t::none) {
+            madvise(p, length, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    // Pages are not touched yet, so binding decides where they are placed
+    if(g_numa_local.load() && !bind_to_local_node(p, length)) {
+        g_numa_failures++;
+    }
+    g_mapped += length;
+    return p;
+}
+
+}
+
+void marl::set_arena_policy(huge_pages_t pages, bool numa_local) {
+    g_pages = static_cast<int>(pages);
+    g_numa_local = numa_local;
+}
+
+void* marl::arena_allocate(size_t bytes) {
+    if(bytes > SIZE_MAX - sizeof(block_header) - huge_page_size) {
+        throw std::bad_alloc();
+    }
+    size_t length = bytes + sizeof(block_header);
+    void* p = nullptr;
+#ifdef MARL_COUNT_ALLOCATIONS
+    count_allocation();
+#endif
+    const bool mapped = length >= arena_threshold
+                        && (g_pages.load() != static_cast<int>(huge_pages_t::none)
+                            || g_numa_local.load());
+    if(mapped) {
+        p = map(length);
+    } else if(posix_memalign(&p, alignof(block_header), length) != 0) {
+        p = nullptr;
+    }
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    block_header* header = static_cast<block_header*>(p);
+    header->length = mapped ? length : 0;
+    return header + 1;
+}
+
+void marl::arena_deallocate(void* p) {
+    if(!p) {
+        return;
+    }
+    block_header* header = static_cast<block_header*>(p) - 1;
+    if(header->length == 0) {
+        free(header);
+        return;
+    }
+    g_mapped -= header->length;
+    munmap(header, header->length);
+}
+
+marl::arena_stats marl::get_arena_stats() {
+    arena_stats stats;
+    stats.mapped = g_mapped.load();
+    stats.huge_fallbacks = g_huge_fallbacks.load();
+    stats.numa_failures = g_numa_failures.load();
+    return stats;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_ARENA_HPP
+#define MARL_ARENA_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace marl {
+
+enum class huge_pages_t {
+    none,           // Plain heap memory
+    transparent,    // Anonymous mappings advised to use transparent huge pages
+    hugetlb         // Explicit huge pages from the hugetlbfs pool
+};
+
+// Counters of what large allocations actually got
+struct arena_stats {
+    size_t mapped;          // bytes currently mapped for large allocations
+    size_t huge_fallbacks;  // hugetlb requests served by normal pages
+    size_t numa_failures;   // mappings that could not be bound to a node
+};
+
+/*
+ * Process-wide policy for the memory behind large arrays: the Q-Table columns,
+ * its indices and hash map, and flattened environment arrays. Allocations of
+ * at least `arena_threshold' bytes are mapped directly, backed by huge pages
+ * as the policy requests, and optionally bound to the NUMA node of the thread
+ * allocating them. As the learner builds its tables itself, that is the node
+ * the learner runs on. Smaller allocations come from the heap.
+ *
+ * Explicit huge pages fall back to transparent ones when the pool is empty.
+ * The policy applies to allocations made after it is set.
+ */
+static const size_t arena_threshold = 1 << 20;
+
+void set_arena_policy(huge_pages_t pages, bool numa_local);
+void* arena_allocate(size_t bytes);
+void arena_deallocate(void* p);
+arena_stats get_arena_stats();
+
+// Allocator for containers which should live in the arena
+template<typename T>
+struct arena_allocator {
+    typedef T value_type;
+
+    arena_allocator() = default;
+    template<typename U>
+    arena_allocator(const arena_allocator<U>&) {
+    }
+    T* allocate(size_t n) {
+        if(n > SIZE_MAX / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(arena_allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t) {
+        arena_deallocate(p);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const arena_allocator<T>&, const arena_allocator<U>&) {
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const arena_allocator<T>&, const arena_allocator<U>&) {
+    return false;
+}
+
+template<typename T>
+using arena_vector = std::vector<T, arena_allocator<T>>;
+
+}
+
+#endif // MARL_ARENA_HPP
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "compiled-mdp.hpp"
+#include <unordered_map>
+#include <marl-protocols/state.hpp>
+#include <marl-protocols/action.hpp>
+
+const uint32_t marl::compiled_mdp::npos;
+
+marl::compiled_mdp::compiled_mdp() {
+    clear();
+}
+
+bool marl::compiled_mdp::compile(const std::vector<state*>& states) {
+    clear();
+    std::unordered_map<const state*, uint32_t> index;
+    index.reserve(states.size());
+    for(const state* s : states) {
+        index.emplace(s, static_cast<uint32_t>(index.size()));
+    }
+    m_state_ids.reserve(states.size());
+    m_states.reserve(states.size());
+    m_action_offsets.reserve(states.size() + 1);
+    for(const state* s : states) {
+        m_state_ids.push_back(s->id());
+        m_states.push_back(s);
+        for(const action* a : s->actions()) {
+            m_action_ids.push_back(a->id());
+            m_probabilities.clear();
+            for(const transition* t : a->transitions()) {
+                auto found = index.find(t->to());
+                if(found == index.end()) {
+                    clear();
+                    return false;
+                }
+                m_targets.push_back(found->second);
+                m_rewards.push_back(t->reward());
+                m_probabilities.push_back(t->probability());
+            }
+            m_transition_offsets.push_back(static_cast<uint32_t>(m_targets.size()));
+            m_outcomes.add(m_probabilities.data(), m_probabilities.size());
+        }
+        m_action_offsets.push_back(static_cast<uint32_t>(m_action_ids.size()));
+    }
+    return true;
+}
+
+void marl::compiled_mdp::clear() {
+    m_state_ids.clear();
+    m_states.clear();
+    m_action_offsets.assign(1, 0);
+    m_transition_offsets.assign(1, 0);
+    m_action_ids.clear();
+    m_targets.clear();
+    m_rewards.clear();
+    m_outcomes.clear();
+}
+
+size_t marl::compiled_mdp::bytes() const {
+    return (m_state_ids.size() + m_action_offsets.size() + m_transition_offsets.size()
+            + m_action_ids.size() + m_targets.size()) * sizeof(uint32_t)
+           + m_rewards.size() * sizeof(float) + m_outcomes.bytes();
+}
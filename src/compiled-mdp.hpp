@@ -0,0 +1,134 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_COMPILED_MDP_HPP
+#define MARL_COMPILED_MDP_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "alias-table.hpp"
+#include "arena.hpp"
+#include "exploration.hpp"
+
+namespace marl {
+
+class state;
+
+/*
+ * Flat copy of an environment for the learning loops, which step through
+ * indices instead of chasing the state, action and transition objects of the
+ * loader around the heap. States are numbered by their position in the
+ * environment, actions and transitions are numbered consecutively, those of
+ * one state or action being adjacent (CSR layout):
+ *
+ *   actions of state s       first_action(s) .. first_action(s + 1) - 1
+ *   transitions of action a  first_transition(a) .. first_transition(a + 1) - 1
+ *
+ * Actions of a state are kept in the order of state::actions(), the order of
+ * the actions in its Q-Table row.
+ *
+ * An action with several transitions leads to one of them at random, by their
+ * probabilities. Each action gets an alias table when it is compiled, so a
+ * transition is drawn in O(1) however many outcomes the action has.
+ */
+class compiled_mdp {
+public:
+    static const uint32_t npos = UINT32_MAX;
+
+    compiled_mdp();
+    // Returns false if a transition leads to a state not in states
+    bool compile(const std::vector<state*>& states);
+    void clear();
+    size_t states() const {
+        return m_state_ids.size();
+    }
+    uint32_t id(uint32_t s) const {
+        return m_state_ids[s];
+    }
+    // Loader's object of a state, for what the flat copy does not hold
+    const state* state_at(uint32_t s) const {
+        return m_states[s];
+    }
+    uint32_t first_action(uint32_t s) const {
+        return m_action_offsets[s];
+    }
+    uint32_t actions(uint32_t s) const {
+        return m_action_offsets[s + 1] - m_action_offsets[s];
+    }
+    // Actions of all states
+    size_t action_count() const {
+        return m_action_ids.size();
+    }
+    uint32_t action_id(uint32_t a) const {
+        return m_action_ids[a];
+    }
+    uint32_t first_transition(uint32_t a) const {
+        return m_transition_offsets[a];
+    }
+    uint32_t transitions(uint32_t a) const {
+        return m_transition_offsets[a + 1] - m_transition_offsets[a];
+    }
+    // Transition taken when performing an action, drawn by probability, or
+    // npos if the action has none. Actions with a single transition draw no
+    // random numbers.
+    template<typename Engine>
+    uint32_t sample_transition(uint32_t a, Engine& engine) const {
+        const uint32_t first = m_transition_offsets[a];
+        const uint32_t count = m_transition_offsets[a + 1] - first;
+        if(count == 0) {
+            return npos;
+        }
+        if(count == 1) {
+            return first;
+        }
+        const float u = uniform01(engine);
+        return first + m_outcomes.sample(a, u, uniform01(engine));
+    }
+    // Index of the state a transition leads to
+    uint32_t target(uint32_t t) const {
+        return m_targets[t];
+    }
+    float reward(uint32_t t) const {
+        return m_rewards[t];
+    }
+    // Memory used by the arrays, in bytes
+    size_t bytes() const;
+private:
+    // state -> id and loader object
+    arena_vector<uint32_t> m_state_ids;
+    std::vector<const state*> m_states;
+    // state -> first action, action -> first transition, both have one extra
+    // element marking the end of the last one
+    arena_vector<uint32_t> m_action_offsets;
+    arena_vector<uint32_t> m_transition_offsets;
+    // action -> id
+    arena_vector<uint32_t> m_action_ids;
+    // transition -> target state and reward
+    arena_vector<uint32_t> m_targets;
+    arena_vector<float> m_rewards;
+    // action -> distribution of its transitions, by transition::probability()
+    alias_table m_outcomes;
+    std::vector<float> m_probabilities;
+};
+
+}
+
+#endif // MARL_COMPILED_MDP_HPP
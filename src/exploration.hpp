@@ -0,0 +1,388 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_EXPLORATION_HPP
+#define MARL_EXPLORATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "kernels.hpp"
+#include "q-table.hpp"
+
+namespace marl {
+
+enum class exploration_t {
+    softmax,            // Boltzmann distribution over Q-Values
+    epsilon_greedy,     // Greedy action, or a random one with probability epsilon
+    ucb1                // Greedy on Q-Value plus an upper confidence bound
+};
+
+// How the softmax temperature moves from its initial to its final value
+enum class annealing_t {
+    none,           // Stays at the initial temperature
+    linear,
+    exponential     // Decays by the same factor every episode
+};
+
+// How softmax draws from the Boltzmann distribution
+enum class softmax_sampler_t {
+    inverse_cdf,    // One uniform sample against the cumulative weights
+    gumbel          // Argmax of Q / tau plus Gumbel noise, no normalization
+};
+
+struct exploration_config {
+    exploration_t strategy;
+    annealing_t annealing;
+    softmax_sampler_t sampler;
+    float temperature;          // initial temperature of softmax
+    float min_temperature;      // temperature after the last episode
+    float epsilon;
+    float ucb_c;                // weight of the confidence bound of UCB1
+    uint32_t episodes;          // over which the temperature is annealed
+};
+
+// Uniform sample in (0, 1) from the upper 24 bits of the engine's output
+template<typename Engine>
+inline float uniform01(Engine& engine) {
+    static_assert(Engine::min() == 0, "engine must produce full words");
+    const int shift = std::numeric_limits<typename Engine::result_type>::digits - 24;
+    return (static_cast<float>(static_cast<uint32_t>(engine() >> shift)) + 0.5f)
+           * (1.0f / 16777216.0f);
+}
+
+// Uniform index in [0, n)
+template<typename Engine>
+inline size_t uniform_index(Engine& engine, size_t n) {
+    return std::min(static_cast<size_t>(uniform01(engine) * n), n - 1);
+}
+
+/*
+ * Draws from the Boltzmann distribution of values at the given temperature,
+ * or picks the greedy action at zero temperature. weights must hold n floats.
+ */
+template<typename Engine>
+size_t boltzmann_d(const row_kernels& kernels, const float* values, size_t n,
+                   float temperature, softmax_sampler_t sampler, float* weights,
+                   Engine& engine) {
+    if(n == 0) {
+        return 0;
+    }
+    if(temperature <= 0.0f) {
+        return kernels.argmax(values, n);
+    }
+    if(sampler == softmax_sampler_t::gumbel) {
+        for(size_t i = 0; i < n; ++i) {
+            weights[i] = uniform01(engine);
+        }
+        return gumbel_argmax(values, n, 1.0f / temperature, weights);
+    }
+    // Subtracting the maximum keeps exp() in range for any Q/tau, the largest
+    // weight is one and the distribution is unchanged.
+    const float total = kernels.softmax_weights(values, n, kernels.max_value(values, n),
+                                                1.0f / temperature, weights);
+    const float target = uniform01(engine) * total;
+    float sum = 0.0f;
+    for(size_t i = 0; i < n; ++i) {
+        sum += weights[i];
+        if(target < sum) {
+            return i;
+        }
+    }
+    // Rounding may leave the sum of the weights slightly below total
+    return n - 1;
+}
+
+/*
+ * Draws one action for each of count states of a table from the Boltzmann
+ * distribution of its row, writing its position in the row to actions, or
+ * q_table::npos if the state has no row. Rows are packed back to back, shifted
+ * by their cached maximum, so a single exp() pass fills the vector lanes even
+ * when rows are a few actions wide. The Gumbel sampler skips that pass and
+ * takes the argmax of each packed row plus noise instead.
+ */
+template<typename Engine>
+void boltzmann_batch(const q_table& table, const uint32_t* states, size_t count,
+                     float temperature, softmax_sampler_t sampler, uint32_t* actions,
+                     std::vector<float>& scratch, Engine& engine) {
+    // Packed rows first, then their weights
+    size_t width = 0;
+    for(size_t i = 0; i < count; ++i) {
+        width += table.row(states[i]).size();
+    }
+    if(scratch.size() < 2 * width) {
+        scratch.resize(2 * width);
+    }
+    float* packed = scratch.data();
+    float* weights = packed + width;
+    const float scale = temperature > 0.0f ? 1.0f / temperature : 0.0f;
+    size_t k = 0;
+    for(size_t i = 0; i < count; ++i) {
+        const q_row row = table.row(states[i]);
+        const float* values = table.values(row, packed + k);
+        const float shift = table.row_max(row);
+        for(size_t n = 0; n < row.size(); ++n) {
+            packed[k + n] = (values[n] - shift) * scale;
+        }
+        k += row.size();
+    }
+    const bool gumbel = sampler == softmax_sampler_t::gumbel;
+    if(!gumbel) {
+        softmax_weights(packed, width, 0.0f, 1.0f, weights);
+    }
+    k = 0;
+    for(size_t i = 0; i < count; ++i) {
+        const q_row row = table.row(states[i]);
+        if(row.empty()) {
+            actions[i] = q_table::npos;
+            continue;
+        }
+        if(temperature <= 0.0f) {
+            actions[i] = table.row_argmax(row);
+            k += row.size();
+            continue;
+        }
+        if(gumbel) {
+            for(size_t n = 0; n < row.size(); ++n) {
+                weights[k + n] = uniform01(engine);
+            }
+            actions[i] = static_cast<uint32_t>(gumbel_argmax(packed + k, row.size(), 1.0f,
+                                                             weights + k));
+            k += row.size();
+            continue;
+        }
+        float total = 0.0f;
+        for(size_t n = 0; n < row.size(); ++n) {
+            total += weights[k + n];
+        }
+        const float target = uniform01(engine) * total;
+        float sum = 0.0f;
+        uint32_t selected = static_cast<uint32_t>(row.size() - 1);
+        for(size_t n = 0; n < row.size(); ++n) {
+            sum += weights[k + n];
+            if(target < sum) {
+                selected = static_cast<uint32_t>(n);
+                break;
+            }
+        }
+        actions[i] = selected;
+        k += row.size();
+    }
+}
+
+/*
+ * Exploration strategies the learning loops are instantiated on. Each one
+ * selects among the actions of a row given their values, is told which action
+ * was performed and when an episode ends:
+ *
+ *   size_t select(const q_row& row, const float* values, Engine& engine);
+ *   // Same for the rows of count states of a table at once, see
+ *   // boltzmann_batch() for the output
+ *   void select_batch(const q_table& table, const uint32_t* states,
+ *                     size_t count, uint32_t* actions, Engine& engine);
+ *   // Sizes the buffers of select_batch() for count rows up front
+ *   void reserve_batch(size_t count);
+ *   // Sizes what is kept per row and slot for a table which grows up to
+ *   // rows and slots, so steps past warm-up do not allocate
+ *   void reserve_rows(size_t rows, size_t slots);
+ *   void update(const q_row& row, size_t n);
+ *   void end_episode(uint32_t episode);
+ *
+ * They are plain classes without virtual members, so every call inlines into
+ * the loop. `width' is the number of actions of the widest row, it picks the
+ * row kernels they use.
+ */
+class softmax_exploration {
+public:
+    softmax_exploration(const exploration_config& config, size_t width):
+        m_config(config),
+        m_kernels(row_kernels_for(width)),
+        m_temperature{config.temperature},
+        m_weights(width) {
+    }
+    template<typename Engine>
+    size_t select(const q_row& row, const float* values, Engine& engine) {
+        return boltzmann_d(m_kernels, values, row.size(), m_temperature, m_config.sampler,
+                           m_weights.data(), engine);
+    }
+    template<typename Engine>
+    void select_batch(const q_table& table, const uint32_t* states, size_t count,
+                      uint32_t* actions, Engine& engine) {
+        boltzmann_batch(table, states, count, m_temperature, m_config.sampler, actions,
+                        m_batch, engine);
+    }
+    void reserve_batch(size_t count) {
+        // Packed rows and their weights
+        m_batch.resize(std::max(m_batch.size(), 2 * count * m_weights.size()));
+    }
+    void reserve_rows(size_t, size_t) {
+    }
+    void update(const q_row&, size_t) {
+    }
+    void end_episode(uint32_t episode) {
+        if(m_config.annealing == annealing_t::none || m_config.episodes == 0) {
+            return;
+        }
+        const float t = std::min(1.0f, static_cast<float>(episode) / m_config.episodes);
+        if(m_config.annealing == annealing_t::linear) {
+            m_temperature = m_config.temperature
+                            + t * (m_config.min_temperature - m_config.temperature);
+        } else {
+            m_temperature = m_config.temperature
+                            * std::pow(m_config.min_temperature / m_config.temperature, t);
+        }
+    }
+    float temperature() const {
+        return m_temperature;
+    }
+private:
+    exploration_config m_config;
+    const row_kernels& m_kernels;
+    float m_temperature;
+    std::vector<float> m_weights;
+    std::vector<float> m_batch;
+};
+
+// select_batch() of strategies which have nothing to share across rows
+template<typename Exploration, typename Engine>
+void select_each(Exploration& exploration, const q_table& table, const uint32_t* states,
+                 size_t count, uint32_t* actions, std::vector<float>& scratch,
+                 Engine& engine) {
+    for(size_t i = 0; i < count; ++i) {
+        const q_row row = table.row(states[i]);
+        if(row.empty()) {
+            actions[i] = q_table::npos;
+            continue;
+        }
+        if(scratch.size() < row.size()) {
+            scratch.resize(row.size());
+        }
+        const float* values = table.values(row, scratch.data());
+        actions[i] = static_cast<uint32_t>(exploration.select(row, values, engine));
+    }
+}
+
+class epsilon_greedy_exploration {
+public:
+    epsilon_greedy_exploration(const exploration_config& config, size_t width):
+        m_kernels(row_kernels_for(width)),
+        m_epsilon{config.epsilon},
+        m_values(width) {
+    }
+    template<typename Engine>
+    size_t select(const q_row& row, const float* values, Engine& engine) {
+        if(row.empty()) {
+            return 0;
+        }
+        if(uniform01(engine) < m_epsilon) {
+            return uniform_index(engine, row.size());
+        }
+        return m_kernels.argmax(values, row.size());
+    }
+    template<typename Engine>
+    void select_batch(const q_table& table, const uint32_t* states, size_t count,
+                      uint32_t* actions, Engine& engine) {
+        select_each(*this, table, states, count, actions, m_values, engine);
+    }
+    void reserve_batch(size_t) {
+    }
+    void reserve_rows(size_t, size_t) {
+    }
+    void update(const q_row&, size_t) {
+    }
+    void end_episode(uint32_t) {
+    }
+private:
+    const row_kernels& m_kernels;
+    float m_epsilon;
+    std::vector<float> m_values;
+};
+
+/*
+ * Picks the action maximizing Q + c * sqrt(ln N(s) / N(s, a)), where N counts
+ * how often states and actions were tried, after trying every action of a
+ * state once. Counts are kept per slot and row of the Q-Table.
+ */
+class ucb1_exploration {
+public:
+    ucb1_exploration(const exploration_config& config, size_t width):
+        m_kernels(row_kernels_for(width)),
+        m_c{config.ucb_c},
+        m_scores(width),
+        m_values(width) {
+    }
+    template<typename Engine>
+    size_t select(const q_row& row, const float* values, Engine&) {
+        grow(row);
+        const uint32_t* counts = m_action_visits.data() + row.offset;
+        for(size_t n = 0; n < row.size(); ++n) {
+            if(counts[n] == 0) {
+                return n;
+            }
+        }
+        const float log_visits = std::log(static_cast<float>(m_state_visits[row.index]));
+        for(size_t n = 0; n < row.size(); ++n) {
+            m_scores[n] = values[n] + m_c * std::sqrt(log_visits / counts[n]);
+        }
+        return m_kernels.argmax(m_scores.data(), row.size());
+    }
+    template<typename Engine>
+    void select_batch(const q_table& table, const uint32_t* states, size_t count,
+                      uint32_t* actions, Engine& engine) {
+        select_each(*this, table, states, count, actions, m_values, engine);
+    }
+    void reserve_batch(size_t) {
+    }
+    void reserve_rows(size_t rows, size_t slots) {
+        m_action_visits.resize(std::max(m_action_visits.size(), slots), 0);
+        m_state_visits.resize(std::max(m_state_visits.size(), rows), 0);
+    }
+    void update(const q_row& row, size_t n) {
+        grow(row);
+        m_action_visits[row.offset + n]++;
+        m_state_visits[row.index]++;
+    }
+    void end_episode(uint32_t) {
+    }
+private:
+    // Rows beyond what reserve_rows() was told about, if any
+    void grow(const q_row& row) {
+        if(row.offset + row.size() > m_action_visits.size()) {
+            m_action_visits.resize(row.offset + row.size(), 0);
+        }
+        if(row.index >= m_state_visits.size()) {
+            m_state_visits.resize(row.index + 1, 0);
+        }
+    }
+
+    const row_kernels& m_kernels;
+    float m_c;
+    std::vector<float> m_scores;
+    std::vector<float> m_values;
+    std::vector<uint32_t> m_action_visits;
+    std::vector<uint32_t> m_state_visits;
+};
+
+}
+
+#endif // MARL_EXPLORATION_HPP
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frozen-policy.hpp"
+#include "kernels.hpp"
+#include <algorithm>
+
+marl::frozen_policy::frozen_policy():
+    m_temperature{0.0f} {
+}
+
+void marl::frozen_policy::freeze(const q_table& table, float temperature) {
+    clear();
+    m_temperature = temperature;
+    m_rows.reserve(table.rows());
+    for(size_t r = 0; r < table.rows(); ++r) {
+        const q_row row = table.row_at(r);
+        if(m_weights.size() < row.size()) {
+            m_values.resize(row.size());
+            m_weights.resize(row.size());
+        }
+        if(temperature > 0.0f) {
+            const float* values = table.values(row, m_values.data());
+            softmax_weights(values, row.size(), table.row_max(row), 1.0f / temperature,
+                            m_weights.data());
+        } else {
+            std::fill(m_weights.begin(), m_weights.begin() + row.size(), 0.0f);
+            if(!row.empty()) {
+                m_weights[table.row_argmax(row)] = 1.0f;
+            }
+        }
+        const uint32_t d = m_aliases.add(m_weights.data(), row.size());
+        m_rows.insert(row.state, q_key_map::npos, d);
+    }
+}
+
+void marl::frozen_policy::clear() {
+    m_rows.clear();
+    m_aliases.clear();
+}
+
+bool marl::frozen_policy::empty() const {
+    return m_aliases.distributions() == 0;
+}
+
+float marl::frozen_policy::temperature() const {
+    return m_temperature;
+}
+
+size_t marl::frozen_policy::bytes() const {
+    return m_rows.bytes() + m_aliases.bytes();
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_FROZEN_POLICY_HPP
+#define MARL_FROZEN_POLICY_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "alias-table.hpp"
+#include "exploration.hpp"
+#include "q-key-map.hpp"
+#include "q-table.hpp"
+
+namespace marl {
+
+/*
+ * Boltzmann policy of a Q-Table that no longer changes, e.g. in exploit
+ * runs. freeze() computes the distribution of every row once and keeps it as
+ * an alias table, so drawing an action takes two random numbers and no exp()
+ * or scan of the row. Frozen at zero temperature it is the greedy policy.
+ * The policy is a copy and does not follow later changes to the table.
+ */
+class frozen_policy {
+public:
+    frozen_policy();
+    void freeze(const q_table& table, float temperature);
+    void clear();
+    bool empty() const;
+    // Position in the state's row of a sampled action, npos if it has no row
+    template<typename Engine>
+    uint32_t select(uint32_t state, Engine& engine) const {
+        const uint32_t r = m_rows.find(state, q_key_map::npos);
+        if(r == q_key_map::npos || m_aliases.size(r) == 0) {
+            return q_table::npos;
+        }
+        const float u = uniform01(engine);
+        return m_aliases.sample(r, u, uniform01(engine));
+    }
+    float temperature() const;
+    // Memory used by the policy, in bytes
+    size_t bytes() const;
+private:
+    float m_temperature;
+    // (state, npos) -> distribution
+    q_key_map m_rows;
+    alias_table m_aliases;
+    std::vector<float> m_values;
+    std::vector<float> m_weights;
+};
+
+}
+
+#endif // MARL_FROZEN_POLICY_HPP
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hogwild-table.hpp"
+#include <algorithm>
+
+marl::hogwild_table::hogwild_table():
+    m_kernels{&row_kernels_for(0)} {
+}
+
+void marl::hogwild_table::load(const q_table& table, const compiled_mdp& mdp) {
+    clear();
+    size_t width = 0;
+    m_rows.reserve(mdp.states());
+    for(uint32_t s = 0; s < mdp.states(); ++s) {
+        m_rows.push_back(table.row(mdp.id(s)));
+        width = std::max<size_t>(width, mdp.actions(s));
+    }
+    m_kernels = &row_kernels_for(width);
+    arena_vector<std::atomic<float>>(table.size()).swap(m_values);
+    arena_vector<std::atomic<float>>(table.size()).swap(m_confidences);
+    for(size_t slot = 0; slot < table.size(); ++slot) {
+        m_values[slot].store(table.value(slot), std::memory_order_relaxed);
+        m_confidences[slot].store(table.confidence(slot), std::memory_order_relaxed);
+    }
+}
+
+void marl::hogwild_table::store(q_table& table) const {
+    for(const q_row& row : m_rows) {
+        for(size_t n = 0; n < row.size(); ++n) {
+            table.set_entry(row, n, value(row.offset + n), confidence(row.offset + n));
+        }
+    }
+}
+
+void marl::hogwild_table::clear() {
+    arena_vector<q_row>().swap(m_rows);
+    arena_vector<std::atomic<float>>().swap(m_values);
+    arena_vector<std::atomic<float>>().swap(m_confidences);
+}
+
+size_t marl::hogwild_table::bytes() const {
+    return m_rows.capacity() * sizeof(q_row)
+           + (m_values.capacity() + m_confidences.capacity()) * sizeof(std::atomic<float>);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_HOGWILD_TABLE_HPP
+#define MARL_HOGWILD_TABLE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "arena.hpp"
+#include "compiled-mdp.hpp"
+#include "kernels.hpp"
+#include "q-table.hpp"
+
+namespace marl {
+
+/*
+ * Values and confidences of a Q-Table as relaxed atomic floats, for several
+ * learners updating one table without locks (Hogwild!, Niu et al. 2011).
+ * Every load and store of a slot is atomic, but a read-modify-write is not:
+ * when two threads update a slot at once one of the updates is lost, which
+ * Q-learning tolerates as long as collisions are rare. Rows are looked up by
+ * the index of their state in a compiled_mdp and all of them exist up front,
+ * so the layout never changes while the table is shared. That is why only
+ * dense fp32 tables are loaded: a sparse one would be materialized in full,
+ * and compact values would be widened, losing what they save.
+ *
+ * The table is a copy: load() takes the entries of a q_table and store()
+ * writes them back once the learners are done. Its columns live in the arena
+ * like those of the q_table.
+ */
+class hogwild_table {
+public:
+    hogwild_table();
+    // Copies the rows of all states of mdp from a dense fp32 table
+    void load(const q_table& table, const compiled_mdp& mdp);
+    void store(q_table& table) const;
+    void clear();
+    // Row of the s-th state of the compiled environment
+    const q_row& row(uint32_t s) const {
+        return m_rows[s];
+    }
+    float value(uint32_t slot) const {
+        return m_values[slot].load(std::memory_order_relaxed);
+    }
+    float confidence(uint32_t slot) const {
+        return m_confidences[slot].load(std::memory_order_relaxed);
+    }
+    void set_entry(uint32_t slot, float value, float confidence) {
+        m_values[slot].store(value, std::memory_order_relaxed);
+        m_confidences[slot].store(confidence, std::memory_order_relaxed);
+    }
+    // Copies the values of a row into out, which must hold r.size() floats
+    void values(const q_row& r, float* out) const {
+        for(size_t n = 0; n < r.size(); ++n) {
+            out[n] = value(r.offset + n);
+        }
+    }
+    // Highest value of a row, zero if it is empty. Uses scratch as values().
+    float row_max(const q_row& r, float* scratch) const {
+        if(r.empty()) {
+            return 0.0f;
+        }
+        values(r, scratch);
+        return m_kernels->max_value(scratch, r.size());
+    }
+    // Memory used by the table, in bytes
+    size_t bytes() const;
+private:
+    const row_kernels* m_kernels;
+    arena_vector<q_row> m_rows;
+    // Sized once by load(), atomics can not be moved
+    arena_vector<std::atomic<float>> m_values;
+    arena_vector<std::atomic<float>> m_confidences;
+};
+
+}
+
+#endif // MARL_HOGWILD_TABLE_HPP
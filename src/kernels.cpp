@@ -0,0 +1,503 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX2__)
+static inline float hmax(__m256 v) {
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+#endif
+#if defined(__SSE2__)
+static inline float hmax(__m128 m) {
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+#endif
+
+// Coefficients of the Cephes expf approximation, exp(x) = 2^k * exp(r) with
+// r = x - k * ln(2) split in two parts for precision
+static const float exp_min = -87.3365447f;
+static const float exp_max = 88.3762626f;
+static const float log2e = 1.44269504088896341f;
+static const float ln2_hi = 0.693359375f;
+static const float ln2_lo = -2.12194440e-4f;
+static const float exp_p0 = 1.9875691500e-4f;
+static const float exp_p1 = 1.3981999507e-3f;
+static const float exp_p2 = 8.3334519073e-3f;
+static const float exp_p3 = 4.1665795894e-2f;
+static const float exp_p4 = 1.6666665459e-1f;
+static const float exp_p5 = 5.0000001201e-1f;
+
+// Coefficients of the Cephes logf approximation, log(x) = k * ln(2) + log(m)
+// with m in [sqrt(0.5), sqrt(2))
+static const float sqrt_half = 0.707106781186547524f;
+static const float log_p0 = 7.0376836292e-2f;
+static const float log_p1 = -1.1514610310e-1f;
+static const float log_p2 = 1.1676998740e-1f;
+static const float log_p3 = -1.2420140846e-1f;
+static const float log_p4 = 1.4249322787e-1f;
+static const float log_p5 = -1.6668057665e-1f;
+static const float log_p6 = 2.0000714765e-1f;
+static const float log_p7 = -2.4999993993e-1f;
+static const float log_p8 = 3.3333331174e-1f;
+
+// Only valid for positive normal x
+static inline float log_approx(float x) {
+    int32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    float k = static_cast<float>((bits >> 23) - 126);
+    bits = (bits & 0x807fffff) | 0x3f000000;
+    std::memcpy(&x, &bits, sizeof(x));
+    if(x < sqrt_half) {
+        k -= 1.0f;
+        x = x + x - 1.0f;
+    } else {
+        x = x - 1.0f;
+    }
+    const float z = x * x;
+    float y = log_p0;
+    y = y * x + log_p1;
+    y = y * x + log_p2;
+    y = y * x + log_p3;
+    y = y * x + log_p4;
+    y = y * x + log_p5;
+    y = y * x + log_p6;
+    y = y * x + log_p7;
+    y = y * x + log_p8;
+    y = y * x * z;
+    y += k * ln2_lo;
+    y -= 0.5f * z;
+    return x + y + k * ln2_hi;
+}
+
+static inline float exp_approx(float x) {
+    x = std::min(std::max(x, exp_min), exp_max);
+    const float k = std::floor(x * log2e + 0.5f);
+    x -= k * ln2_hi;
+    x -= k * ln2_lo;
+    float y = exp_p0;
+    y = y * x + exp_p1;
+    y = y * x + exp_p2;
+    y = y * x + exp_p3;
+    y = y * x + exp_p4;
+    y = y * x + exp_p5;
+    y = y * x * x + x + 1.0f;
+    const int32_t bits = (static_cast<int32_t>(k) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return y * scale;
+}
+
+#if defined(__AVX2__)
+static inline __m256 log_approx(__m256 x) {
+    const __m256i bits = _mm256_castps_si256(x);
+    __m256 k = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23),
+                                                   _mm256_set1_epi32(126)));
+    x = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x807fffff)),
+                                            _mm256_set1_epi32(0x3f000000)));
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 below = _mm256_cmp_ps(x, _mm256_set1_ps(sqrt_half), _CMP_LT_OQ);
+    k = _mm256_sub_ps(k, _mm256_and_ps(below, one));
+    x = _mm256_sub_ps(_mm256_add_ps(x, _mm256_and_ps(below, x)), one);
+    const __m256 z = _mm256_mul_ps(x, x);
+    __m256 y = _mm256_set1_ps(log_p0);
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(log_p1));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(log_p2));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(log_p3));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(log_p4));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(log_p5));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(log_p6));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(log_p7));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(log_p8));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+    y = _mm256_add_ps(y, _mm256_mul_ps(k, _mm256_set1_ps(ln2_lo)));
+    y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_set1_ps(0.5f), z));
+    return _mm256_add_ps(_mm256_add_ps(x, y), _mm256_mul_ps(k, _mm256_set1_ps(ln2_hi)));
+}
+
+static inline __m256 exp_approx(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(exp_min)), _mm256_set1_ps(exp_max));
+    const __m256 k = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(log2e)),
+                                                   _mm256_set1_ps(0.5f)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(ln2_hi)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(ln2_lo)));
+    __m256 y = _mm256_set1_ps(exp_p0);
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(exp_p1));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(exp_p2));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(exp_p3));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(exp_p4));
+    y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(exp_p5));
+    y = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(y, x), x),
+                      _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+    const __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(k),
+                                                            _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(bits));
+}
+#endif
+#if defined(__SSE2__)
+static inline __m128 log_approx(__m128 x) {
+    const __m128i bits = _mm_castps_si128(x);
+    __m128 k = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+    x = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x807fffff)),
+                                      _mm_set1_epi32(0x3f000000)));
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 below = _mm_cmplt_ps(x, _mm_set1_ps(sqrt_half));
+    k = _mm_sub_ps(k, _mm_and_ps(below, one));
+    x = _mm_sub_ps(_mm_add_ps(x, _mm_and_ps(below, x)), one);
+    const __m128 z = _mm_mul_ps(x, x);
+    __m128 y = _mm_set1_ps(log_p0);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p1));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p2));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p3));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p4));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p5));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p6));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p7));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(log_p8));
+    y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+    y = _mm_add_ps(y, _mm_mul_ps(k, _mm_set1_ps(ln2_lo)));
+    y = _mm_sub_ps(y, _mm_mul_ps(_mm_set1_ps(0.5f), z));
+    return _mm_add_ps(_mm_add_ps(x, y), _mm_mul_ps(k, _mm_set1_ps(ln2_hi)));
+}
+
+static inline __m128 exp_approx(__m128 x) {
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(exp_min)), _mm_set1_ps(exp_max));
+    // floor() without SSE4.1: truncate, then step down where that rounded up
+    const __m128 f = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(log2e)), _mm_set1_ps(0.5f));
+    __m128 k = _mm_cvtepi32_ps(_mm_cvttps_epi32(f));
+    k = _mm_sub_ps(k, _mm_and_ps(_mm_cmpgt_ps(k, f), _mm_set1_ps(1.0f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(ln2_hi)));
+    x = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(ln2_lo)));
+    __m128 y = _mm_set1_ps(exp_p0);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(exp_p1));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(exp_p2));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(exp_p3));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(exp_p4));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(exp_p5));
+    y = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(y, x), x), _mm_add_ps(x, _mm_set1_ps(1.0f)));
+    const __m128i bits = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(k),
+                                                      _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(y, _mm_castsi128_ps(bits));
+}
+#endif
+
+float marl::max_value(const float* values, size_t n) {
+    float result = -std::numeric_limits<float>::infinity();
+    size_t i = 0;
+#if defined(__AVX2__)
+    if(n >= 8) {
+        __m256 m = _mm256_loadu_ps(values);
+        for(i = 8; i + 8 <= n; i += 8) {
+            m = _mm256_max_ps(m, _mm256_loadu_ps(values + i));
+        }
+        result = hmax(m);
+    }
+#elif defined(__SSE2__)
+    if(n >= 4) {
+        __m128 m = _mm_loadu_ps(values);
+        for(i = 4; i + 4 <= n; i += 4) {
+            m = _mm_max_ps(m, _mm_loadu_ps(values + i));
+        }
+        result = hmax(m);
+    }
+#endif
+    for(; i < n; ++i) {
+        result = values[i] > result ? values[i] : result;
+    }
+    return result;
+}
+
+size_t marl::argmax(const float* values, size_t n) {
+    if(n == 0) {
+        return 0;
+    }
+    // Find the maximum vectorized, then the first slot holding it
+    const float m = max_value(values, n);
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 mv = _mm256_set1_ps(m);
+    for(; i + 8 <= n; i += 8) {
+        const int mask = _mm256_movemask_ps(
+                             _mm256_cmp_ps(_mm256_loadu_ps(values + i), mv, _CMP_EQ_OQ));
+        if(mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128 mv = _mm_set1_ps(m);
+    for(; i + 4 <= n; i += 4) {
+        const int mask = _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(values + i), mv));
+        if(mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for(; i < n; ++i) {
+        if(values[i] == m) {
+            return i;
+        }
+    }
+    // Only reachable when values hold NaNs
+    return 0;
+}
+
+size_t marl::gumbel_argmax(const float* values, size_t n, float scale, float* u) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 kv = _mm256_set1_ps(scale);
+    const __m256 zero = _mm256_setzero_ps();
+    for(; i + 8 <= n; i += 8) {
+        // -log(-log(u)), as log(-log(u)) subtracted
+        const __m256 g = log_approx(_mm256_sub_ps(zero, log_approx(_mm256_loadu_ps(u + i))));
+        _mm256_storeu_ps(u + i, _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(values + i), kv), g));
+    }
+#elif defined(__SSE2__)
+    const __m128 kv = _mm_set1_ps(scale);
+    const __m128 zero = _mm_setzero_ps();
+    for(; i + 4 <= n; i += 4) {
+        const __m128 g = log_approx(_mm_sub_ps(zero, log_approx(_mm_loadu_ps(u + i))));
+        _mm_storeu_ps(u + i, _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(values + i), kv), g));
+    }
+#endif
+    for(; i < n; ++i) {
+        u[i] = values[i] * scale - log_approx(-log_approx(u[i]));
+    }
+    return argmax(u, n);
+}
+
+void marl::weighted_sum(float* q, float* c, const float* v, const float* w, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for(; i + 8 <= n; i += 8) {
+        const __m256 wv = _mm256_loadu_ps(w + i);
+        _mm256_storeu_ps(q + i, _mm256_add_ps(_mm256_loadu_ps(q + i),
+                                              _mm256_mul_ps(wv, _mm256_loadu_ps(v + i))));
+        _mm256_storeu_ps(c + i, _mm256_add_ps(_mm256_loadu_ps(c + i), wv));
+    }
+#elif defined(__SSE2__)
+    for(; i + 4 <= n; i += 4) {
+        const __m128 wv = _mm_loadu_ps(w + i);
+        _mm_storeu_ps(q + i, _mm_add_ps(_mm_loadu_ps(q + i),
+                                        _mm_mul_ps(wv, _mm_loadu_ps(v + i))));
+        _mm_storeu_ps(c + i, _mm_add_ps(_mm_loadu_ps(c + i), wv));
+    }
+#endif
+    for(; i < n; ++i) {
+        q[i] += w[i] * v[i];
+        c[i] += w[i];
+    }
+}
+
+float marl::softmax_weights(const float* values, size_t n, float shift, float scale,
+                            float* out) {
+    float total = 0.0f;
+    size_t i = 0;
+#if defined(__AVX2__)
+    if(n >= 8) {
+        const __m256 sv = _mm256_set1_ps(shift);
+        const __m256 kv = _mm256_set1_ps(scale);
+        __m256 t = _mm256_setzero_ps();
+        for(; i + 8 <= n; i += 8) {
+            const __m256 x = _mm256_sub_ps(_mm256_loadu_ps(values + i), sv);
+            const __m256 e = exp_approx(_mm256_mul_ps(x, kv));
+            _mm256_storeu_ps(out + i, e);
+            t = _mm256_add_ps(t, e);
+        }
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(t), _mm256_extractf128_ps(t, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        total = _mm_cvtss_f32(s);
+    }
+#elif defined(__SSE2__)
+    if(n >= 4) {
+        const __m128 sv = _mm_set1_ps(shift);
+        const __m128 kv = _mm_set1_ps(scale);
+        __m128 t = _mm_setzero_ps();
+        for(; i + 4 <= n; i += 4) {
+            const __m128 x = _mm_sub_ps(_mm_loadu_ps(values + i), sv);
+            const __m128 e = exp_approx(_mm_mul_ps(x, kv));
+            _mm_storeu_ps(out + i, e);
+            t = _mm_add_ps(t, e);
+        }
+        t = _mm_add_ps(t, _mm_movehl_ps(t, t));
+        t = _mm_add_ss(t, _mm_shuffle_ps(t, t, 1));
+        total = _mm_cvtss_f32(t);
+    }
+#endif
+    for(; i < n; ++i) {
+        out[i] = exp_approx((values[i] - shift) * scale);
+        total += out[i];
+    }
+    return total;
+}
+
+#if defined(__SSE2__)
+static inline float hsum(__m128 t) {
+    t = _mm_add_ps(t, _mm_movehl_ps(t, t));
+    t = _mm_add_ss(t, _mm_shuffle_ps(t, t, 1));
+    return _mm_cvtss_f32(t);
+}
+
+// Row of n <= N values padded to N with pad, copied into row unless it is
+// already N wide
+template<size_t N>
+static inline const float* fixed_row(const float* values, size_t n, float pad,
+                                     float (&row)[N]) {
+    if(n == N) {
+        return values;
+    }
+    for(size_t i = 0; i < N; ++i) {
+        row[i] = i < n ? values[i] : pad;
+    }
+    return row;
+}
+
+template<size_t N>
+static float fixed_max_value(const float* values, size_t n) {
+    if(n > N) {
+        return marl::max_value(values, n);
+    }
+    float padded[N];
+    const float* row = fixed_row(values, n, -std::numeric_limits<float>::infinity(), padded);
+    __m128 m = _mm_loadu_ps(row);
+    for(size_t i = 4; i < N; i += 4) {
+        m = _mm_max_ps(m, _mm_loadu_ps(row + i));
+    }
+    return hmax(m);
+}
+
+template<size_t N>
+static size_t fixed_argmax(const float* values, size_t n) {
+    if(n > N) {
+        return marl::argmax(values, n);
+    }
+    if(n == 0) {
+        return 0;
+    }
+    float padded[N];
+    const float* row = fixed_row(values, n, -std::numeric_limits<float>::infinity(), padded);
+    __m128 m = _mm_loadu_ps(row);
+    for(size_t i = 4; i < N; i += 4) {
+        m = _mm_max_ps(m, _mm_loadu_ps(row + i));
+    }
+    const __m128 mv = _mm_set1_ps(hmax(m));
+    int mask = 0;
+    for(size_t i = 0; i < N; i += 4) {
+        mask |= _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(row + i), mv)) << i;
+    }
+    // No bit is set only when values hold NaNs
+    return mask ? __builtin_ctz(mask) : 0;
+}
+
+template<size_t N>
+static float fixed_softmax_weights(const float* values, size_t n, float shift, float scale,
+                                   float* out) {
+    if(n > N) {
+        return marl::softmax_weights(values, n, shift, scale, out);
+    }
+    float padded[N];
+    const float* row = fixed_row(values, n, shift, padded);
+    float* weights = n == N ? out : padded;
+    const __m128 sv = _mm_set1_ps(shift);
+    const __m128 kv = _mm_set1_ps(scale);
+    for(size_t i = 0; i < N; i += 4) {
+        const __m128 x = _mm_sub_ps(_mm_loadu_ps(row + i), sv);
+        _mm_storeu_ps(weights + i, exp_approx(_mm_mul_ps(x, kv)));
+    }
+    if(n != N) {
+        // Padding must not count towards the total
+        for(size_t i = n; i < N; ++i) {
+            padded[i] = 0.0f;
+        }
+        std::memcpy(out, padded, n * sizeof(float));
+    }
+    __m128 t = _mm_loadu_ps(weights);
+    for(size_t i = 4; i < N; i += 4) {
+        t = _mm_add_ps(t, _mm_loadu_ps(weights + i));
+    }
+    return hsum(t);
+}
+
+template<size_t N>
+static void fixed_weighted_sum(float* q, float* c, const float* v, const float* w, size_t n) {
+    if(n > N) {
+        marl::weighted_sum(q, c, v, w, n);
+        return;
+    }
+    float qp[N], cp[N], vp[N], wp[N];
+    float* qr = n == N ? q : qp;
+    float* cr = n == N ? c : cp;
+    fixed_row(q, n, 0.0f, qp);
+    fixed_row(c, n, 0.0f, cp);
+    const float* vr = fixed_row(v, n, 0.0f, vp);
+    const float* wr = fixed_row(w, n, 0.0f, wp);
+    for(size_t i = 0; i < N; i += 4) {
+        const __m128 wv = _mm_loadu_ps(wr + i);
+        _mm_storeu_ps(qr + i, _mm_add_ps(_mm_loadu_ps(qr + i),
+                                         _mm_mul_ps(wv, _mm_loadu_ps(vr + i))));
+        _mm_storeu_ps(cr + i, _mm_add_ps(_mm_loadu_ps(cr + i), wv));
+    }
+    if(n != N) {
+        std::memcpy(q, qp, n * sizeof(float));
+        std::memcpy(c, cp, n * sizeof(float));
+    }
+}
+
+template<size_t N>
+static marl::row_kernels fixed_row_kernels() {
+    marl::row_kernels k;
+    k.width = N;
+    k.max_value = fixed_max_value<N>;
+    k.argmax = fixed_argmax<N>;
+    k.softmax_weights = fixed_softmax_weights<N>;
+    k.weighted_sum = fixed_weighted_sum<N>;
+    return k;
+}
+#endif
+
+const marl::row_kernels& marl::row_kernels_for(size_t max_actions) {
+    static const row_kernels generic = {0, max_value, argmax, softmax_weights, weighted_sum};
+#if defined(__SSE2__)
+    static const row_kernels fixed4 = fixed_row_kernels<4>();
+    static const row_kernels fixed8 = fixed_row_kernels<8>();
+    if(max_actions <= 4) {
+        return fixed4;
+    }
+    if(max_actions <= 8) {
+        return fixed8;
+    }
+#else
+    (void)max_actions;
+#endif
+    return generic;
+}
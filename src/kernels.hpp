@@ -0,0 +1,68 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_KERNELS_HPP
+#define MARL_KERNELS_HPP
+
+#include <cstddef>
+
+/*
+ * Reductions over the values of a Q-Table row. Each kernel has an AVX2 and an
+ * SSE2 implementation, picked at compile time from the target flags (build
+ * with -mavx2 or -march=native to get the AVX2 one), and a scalar fallback.
+ */
+namespace marl {
+
+// Maximum of values, -infinity if n is zero
+float max_value(const float* values, size_t n);
+// Index of the first maximum of values, zero if n is zero
+size_t argmax(const float* values, size_t n);
+// out[i] = exp((values[i] - shift) * scale), returns the sum of out. The
+// exponential is a polynomial approximation accurate to about 2 ulp, inputs
+// are clamped to [-87.3, 88.3] so the result is always finite.
+float softmax_weights(const float* values, size_t n, float shift, float scale, float* out);
+// Index of the maximum of values[i] * scale + g[i], where g[i] is Gumbel noise
+// -log(-log(u[i])) of the uniform samples u in (0, 1). Overwrites u.
+size_t gumbel_argmax(const float* values, size_t n, float scale, float* u);
+// q[i] += w[i] * v[i] and c[i] += w[i]
+void weighted_sum(float* q, float* c, const float* v, const float* w, size_t n);
+
+/*
+ * The kernels above for the rows of one problem. When no row has more than 4
+ * or 8 actions, rows are copied into fixed-size arrays on the stack, padded
+ * to that width, and reduced with a fixed number of fully unrolled SSE2
+ * operations instead of loops. Wider rows, or targets without SSE2, use the
+ * generic kernels. Pick them once, before learning, with row_kernels_for().
+ */
+struct row_kernels {
+    size_t width;       // rows of up to this many actions are unrolled, 0 for none
+    float (*max_value)(const float* values, size_t n);
+    size_t (*argmax)(const float* values, size_t n);
+    float (*softmax_weights)(const float* values, size_t n, float shift, float scale,
+                             float* out);
+    void (*weighted_sum)(float* q, float* c, const float* v, const float* w, size_t n);
+};
+
+// Kernels for rows of at most max_actions actions
+const row_kernels& row_kernels_for(size_t max_actions);
+
+}
+
+#endif // MARL_KERNELS_HPP
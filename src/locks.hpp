@@ -0,0 +1,129 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_LOCKS_HPP
+#define MARL_LOCKS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+
+namespace marl {
+
+/*
+ * Sequence lock for one writer and any number of readers. Readers never
+ * block the writer; they retry if a write happened while they were reading.
+ * Padded to a cache line so neighbouring locks do not share one.
+ *
+ * The data it guards is read while it is written, so both sides must access
+ * it with relaxed_load() and relaxed_store() for that not to be a data race.
+ * The fences below order those accesses against the sequence.
+ */
+class seqlock {
+public:
+    seqlock():
+        m_sequence{0} {
+    }
+    uint32_t read_begin() const {
+        uint32_t s;
+        while((s = m_sequence.load(std::memory_order_acquire)) & 1) {
+            // A write is in progress
+        }
+        return s;
+    }
+    // True if the data read since read_begin() may be torn
+    bool read_retry(uint32_t s) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_sequence.load(std::memory_order_relaxed) != s;
+    }
+    void write_begin() {
+        m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    void write_end() {
+        m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_release);
+    }
+private:
+    std::atomic<uint32_t> m_sequence;
+    char m_padding[64 - sizeof(std::atomic<uint32_t>)];
+};
+
+// Relaxed atomic access to plain memory, which C++11 can not express (it has
+// no atomic_ref). Uses the GCC and Clang builtins, which accept any trivially
+// copyable type and compile to plain loads and stores for aligned words.
+template<typename T>
+inline T relaxed_load(const T& x) {
+    T v;
+    __atomic_load(&x, &v, __ATOMIC_RELAXED);
+    return v;
+}
+
+template<typename T>
+inline void relaxed_store(T& x, T v) {
+    __atomic_store(&x, &v, __ATOMIC_RELAXED);
+}
+
+// Reader/writer lock, C++11 has none in the standard library
+class rw_lock {
+public:
+    rw_lock() {
+        pthread_rwlock_init(&m_lock, nullptr);
+    }
+    ~rw_lock() {
+        pthread_rwlock_destroy(&m_lock);
+    }
+    rw_lock(const rw_lock&) = delete;
+    rw_lock& operator=(const rw_lock&) = delete;
+    void lock_shared() {
+        pthread_rwlock_rdlock(&m_lock);
+    }
+    void unlock_shared() {
+        pthread_rwlock_unlock(&m_lock);
+    }
+    void lock() {
+        pthread_rwlock_wrlock(&m_lock);
+    }
+    void unlock() {
+        pthread_rwlock_unlock(&m_lock);
+    }
+private:
+    pthread_rwlock_t m_lock;
+};
+
+class shared_guard {
+public:
+    explicit shared_guard(rw_lock& lock):
+        m_lock(lock) {
+        m_lock.lock_shared();
+    }
+    ~shared_guard() {
+        m_lock.unlock_shared();
+    }
+    shared_guard(const shared_guard&) = delete;
+    shared_guard& operator=(const shared_guard&) = delete;
+private:
+    rw_lock& m_lock;
+};
+
+}
+
+#endif // MARL_LOCKS_HPP
@@ -60,8 +60,8 @@ static std::string usage_message =
     "                 must be set.\n"
     "                 Default mode is \"learn\".\n"
     "  -n N, --episodes=N\n"
-    "                 Number of episodes in learning stage.\n"
-    "                 will be ignored on exploit mode.\n"
+    "                 Number of episodes to run. On exploit mode episodes follow\n"
+    "                 the greedy policy of the input Q-Table.\n"
     "  -r N, --learning-rate=N\n"
     "                 The learning rate or step size determines to what extent newly\n"
     "                 acquired information overrides old information. A factor of 0\n"
@@ -78,6 +78,28 @@ static std::string usage_message =
     "                 1 will make it strive for a long-term high reward.\n"
     "                 You must provide a number between 0 and 1.\n"
     "                 Default value is: `0.5'.\n"
+    "  -e [softmax|epsilon-greedy|ucb1], --exploration=[softmax|epsilon-greedy|ucb1]\n"
+    "                 Strategy used to pick actions while learning. \"softmax\"\n"
+    "                 draws from the Boltzmann distribution of Q-Values (see\n"
+    "                 '--temperature'), \"epsilon-greedy\" takes the best looking\n"
+    "                 action or, with probability epsilon, a random one, \"ucb1\"\n"
+    "                 takes the action with the highest Q-Value plus a bonus that\n"
+    "                 shrinks the more often it was tried.\n"
+    "                 Default value is: `softmax'.\n"
+    "  -g N, --epsilon=N\n"
+    "                 Probability of a random action on epsilon-greedy exploration.\n"
+    "                 Default value is: `0.1'.\n"
+    "  -u N, --ucb-c=N\n"
+    "                 Weight of the exploration bonus on ucb1 exploration.\n"
+    "                 Default value is: `1.414'.\n"
+    "  -A [none|linear|exponential], --annealing=[none|linear|exponential]\n"
+    "                 Lowers the softmax temperature from '--temperature' to\n"
+    "                 '--min-temperature' over all episodes, linearly or by the\n"
+    "                 same factor every episode.\n"
+    "                 Default value is: `none'.\n"
+    "  -T N, --min-temperature=N\n"
+    "                 Softmax temperature after the last episode when annealing.\n"
+    "                 Default value is: `0.01'.\n"
     "  -t N, --temperature=N\n"
     "                 Temperature of the Boltzmann distribution used to decide which \n"
     "                 action to perform amongst possibilities.\n"
@@ -87,12 +109,88 @@ static std::string usage_message =
     "                 suggests, the agent will likely perform random actions.\n"
     "                 You must provide a number between 0 and infinity.\n"
     "                 Default value is: `50'.\n"
+    "  -b [inverse-cdf|gumbel], --softmax-sampler=[inverse-cdf|gumbel]\n"
+    "                 How actions are drawn from the Boltzmann distribution.\n"
+    "                 \"inverse-cdf\" normalizes the weights of all actions and\n"
+    "                 draws one random number against them, \"gumbel\" perturbs\n"
+    "                 each Q-Value with random noise and takes the maximum. Both\n"
+    "                 select actions with the same probabilities.\n"
+    "                 Default value is: `inverse-cdf'.\n"
+    "  -F N, --exploit-temperature=N\n"
+    "                 Temperature of the Boltzmann distribution actions are drawn\n"
+    "                 from in exploit mode. Its distributions are computed once\n"
+    "                 when the policy is loaded. A factor of 0 performs the best\n"
+    "                 looking action.\n"
+    "                 Default value is: `0'.\n"
+    "  -O [environment|bfs|rcm], --state-order=[environment|bfs|rcm]\n"
+    "                 Order in which states are laid out in memory. \"bfs\" and\n"
+    "                 \"rcm\" (reverse Cuthill-McKee) put states connected by\n"
+    "                 transitions close to each other for better cache use.\n"
+    "                 State IDs in policy files and messages are unchanged.\n"
+    "                 Default value is: `environment'.\n"
+    "  -j N, --threads=N\n"
+    "                 Number of threads learning in single-agent mode. They share\n"
+    "                 one Q-Table, updated without locks, and split the episodes\n"
+    "                 among them. Each thread draws from its own part of the\n"
+    "                 agent's random stream. Needs a dense table of 32 bit floats\n"
+    "                 (the defaults of '--q-table' and '--q-storage'), as the\n"
+    "                 threads work on a full copy of it. With UCB1 exploration\n"
+    "                 every thread counts only its own visits, so its bounds\n"
+    "                 shrink as if it learned alone.\n"
+    "                 Default value is: `1'.\n"
+    "  -k N, --lockstep=N\n"
+    "                 Number of episodes learned side by side in single-agent\n"
+    "                 mode. Each learning step selects actions for all of them\n"
+    "                 at once, then moves and updates each one, which keeps the\n"
+    "                 vector units busy on narrow rows. Cannot be combined with\n"
+    "                 '--threads'.\n"
+    "                 Default value is: `1'.\n"
+    "  -z N, --seed=N\n"
+    "                 Seed of the random number generator, runs with the same seed\n"
+    "                 and options are repeatable. Every agent draws from its own\n"
+    "                 stream of the seed, picked by its ID.\n"
+    "                 Default is a random seed.\n"
     "  -o PATH, --policy-output=PATH\n"
     "                 File name to write learned policy to.\n"
     "                 Will be ignored on exploit mode.\n"
     "  -i PATH, --policy-input=PATH\n"
     "                 File name to read learned policy from.\n"
     "                 Will be ignored on learning mode.\n"
+    "  -q [dense|sparse], --q-table=[dense|sparse]\n"
+    "                 Storage layout of the Q-Table. A \"dense\" table allocates\n"
+    "                 an entry for every state and action of the problem up front.\n"
+    "                 A \"sparse\" table only allocates entries of states that are\n"
+    "                 actually visited, which suits huge problems that are mostly\n"
+    "                 left unexplored.\n"
+    "                 Default value is: `dense'.\n"
+    "  -Q [fp32|fp16|bf16|int8], --q-storage=[fp32|fp16|bf16|int8]\n"
+    "                 Encoding of Q-Values in memory. \"fp16\" and \"bf16\" halve\n"
+    "                 the memory used by values, \"int8\" quarters it, at the cost\n"
+    "                 of precision. Values are stored as 8 bit integers with a\n"
+    "                 common scale per block of 16 entries then. Confidences are\n"
+    "                 always stored as 32 bit floats.\n"
+    "                 Default value is: `fp32'.\n"
+    "  -R, --storage-report\n"
+    "                 Log memory use and accuracy of the final Q-Table on each\n"
+    "                 storage encoding. Errors are measured against the table as\n"
+    "                 stored with -Q, so they do not include the precision lost\n"
+    "                 while learning on a compact encoding.\n"
+    "  -E N, --publish-interval=N\n"
+    "                 Answer other agents from a copy of the Q-Table which is\n"
+    "                 refreshed every N learning steps, so learning never waits\n"
+    "                 for them. Larger values copy the table less often but serve\n"
+    "                 staler values. Zero serves the live table instead.\n"
+    "                 Will be ignored on single-agent mode.\n"
+    "                 Default value is: `0'.\n"
+    "  -H [none|transparent|hugetlb], --huge-pages=[none|transparent|hugetlb]\n"
+    "                 Back large arrays such as the Q-Table with huge pages, which\n"
+    "                 cuts TLB misses on big tables. \"transparent\" advises the\n"
+    "                 kernel to use transparent huge pages, \"hugetlb\" takes them\n"
+    "                 from the reserved pool (see /proc/sys/vm/nr_hugepages) and\n"
+    "                 falls back to transparent ones when it runs out.\n"
+    "                 Default value is: `none'.\n"
+    "  -N, --numa-local\n"
+    "                 Place large arrays on the NUMA node of the learning thread.\n"
     "  -x PATH, --stats-file=PATH\n"
     "                 File name to write eisodes statistics into.\n"
     "  -v N, --log-level=N\n"
@@ -135,9 +233,24 @@ int main(int argc, char* argv[]) {
     float discount_factor = 0.5;
     marl::learning_mode_t learning_mode = marl::learning_mode_t::learn;
     marl::operation_mode_t operation_mode = marl::operation_mode_t::single;
+    marl::q_layout_t q_layout = marl::q_layout_t::dense;
+    marl::q_storage_t q_storage = marl::q_storage_t::fp32;
+    uint32_t publish_interval = 0;
+    marl::huge_pages_t huge_pages = marl::huge_pages_t::none;
+    marl::softmax_sampler_t softmax_sampler = marl::softmax_sampler_t::inverse_cdf;
+    marl::exploration_t exploration = marl::exploration_t::softmax;
+    marl::annealing_t annealing = marl::annealing_t::none;
+    float min_temperature = 0.01;
+    float epsilon = 0.1;
+    float ucb_c = 1.414;
+    uint64_t seed = 0;
+    uint32_t threads = 1;
+    uint32_t lockstep = 1;
+    float exploit_temperature = 0;
+    marl::state_order_t state_order = marl::state_order_t::environment;
     int c;
     std::map<char, bool> set_arguments;
-    char all_args[] = "hSPpasmlnoirtdv";
+    char all_args[] = "hSPpasmlnoirtdvqQREHNbeguATzFOjk";
     for(size_t i = 0; i < strlen(all_args); ++i) {
         set_arguments[all_args[i]] = false;
     }
@@ -159,10 +272,27 @@ int main(int argc, char* argv[]) {
             {"discount-factor",   required_argument, 0, 'd'},
             {"log-level",   required_argument, 0, 'v'},
             {"stats-file",   required_argument, 0, 'x'},
+            {"q-table",   required_argument, 0, 'q'},
+            {"q-storage",   required_argument, 0, 'Q'},
+            {"storage-report",   no_argument, 0, 'R'},
+            {"publish-interval",   required_argument, 0, 'E'},
+            {"huge-pages",   required_argument, 0, 'H'},
+            {"numa-local",   no_argument, 0, 'N'},
+            {"softmax-sampler",   required_argument, 0, 'b'},
+            {"exploration",   required_argument, 0, 'e'},
+            {"epsilon",   required_argument, 0, 'g'},
+            {"ucb-c",   required_argument, 0, 'u'},
+            {"annealing",   required_argument, 0, 'A'},
+            {"min-temperature",   required_argument, 0, 'T'},
+            {"seed",   required_argument, 0, 'z'},
+            {"exploit-temperature",   required_argument, 0, 'F'},
+            {"state-order",   required_argument, 0, 'O'},
+            {"threads",   required_argument, 0, 'j'},
+            {"lockstep",   required_argument, 0, 'k'},
             {0, 0, 0, 0}
         };
         int option_index = 0;
-        c = getopt_long(argc, argv, "hS:P:p:a:s:m:l:n:o:i:r:t:d:v:x:", long_options, &option_index);
+        c = getopt_long(argc, argv, "hS:P:p:a:s:m:l:n:o:i:r:t:d:v:x:q:Q:RE:H:Nb:e:g:u:A:T:z:F:O:j:k:", long_options, &option_index);
         if(c == -1) {
             break;
         }
@@ -210,6 +340,116 @@ int main(int argc, char* argv[]) {
                     exit(EXIT_FAILURE);
                 }
                 break;
+            case 'q':
+                if(strcmp(optarg, "dense") == 0) {
+                    q_layout = marl::q_layout_t::dense;
+                } else if(strcmp(optarg, "sparse") == 0) {
+                    q_layout = marl::q_layout_t::sparse;
+                } else {
+                    std::cerr << "Unknown Q-Table layout: `" << optarg << "'!\n";
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'Q':
+                if(strcmp(optarg, "fp32") == 0) {
+                    q_storage = marl::q_storage_t::fp32;
+                } else if(strcmp(optarg, "fp16") == 0) {
+                    q_storage = marl::q_storage_t::fp16;
+                } else if(strcmp(optarg, "bf16") == 0) {
+                    q_storage = marl::q_storage_t::bf16;
+                } else if(strcmp(optarg, "int8") == 0) {
+                    q_storage = marl::q_storage_t::int8;
+                } else {
+                    std::cerr << "Unknown Q-Table storage: `" << optarg << "'!\n";
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'R':
+                break;
+            case 'E':
+                publish_interval = std::stoi(std::string{optarg});
+                break;
+            case 'H':
+                if(strcmp(optarg, "none") == 0) {
+                    huge_pages = marl::huge_pages_t::none;
+                } else if(strcmp(optarg, "transparent") == 0) {
+                    huge_pages = marl::huge_pages_t::transparent;
+                } else if(strcmp(optarg, "hugetlb") == 0) {
+                    huge_pages = marl::huge_pages_t::hugetlb;
+                } else {
+                    std::cerr << "Unknown huge pages mode: `" << optarg << "'!\n";
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'N':
+                break;
+            case 'b':
+                if(strcmp(optarg, "inverse-cdf") == 0) {
+                    softmax_sampler = marl::softmax_sampler_t::inverse_cdf;
+                } else if(strcmp(optarg, "gumbel") == 0) {
+                    softmax_sampler = marl::softmax_sampler_t::gumbel;
+                } else {
+                    std::cerr << "Unknown softmax sampler: `" << optarg << "'!\n";
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'e':
+                if(strcmp(optarg, "softmax") == 0) {
+                    exploration = marl::exploration_t::softmax;
+                } else if(strcmp(optarg, "epsilon-greedy") == 0) {
+                    exploration = marl::exploration_t::epsilon_greedy;
+                } else if(strcmp(optarg, "ucb1") == 0) {
+                    exploration = marl::exploration_t::ucb1;
+                } else {
+                    std::cerr << "Unknown exploration strategy: `" << optarg << "'!\n";
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'g':
+                epsilon = std::stof(std::string{optarg});
+                break;
+            case 'u':
+                ucb_c = std::stof(std::string{optarg});
+                break;
+            case 'A':
+                if(strcmp(optarg, "none") == 0) {
+                    annealing = marl::annealing_t::none;
+                } else if(strcmp(optarg, "linear") == 0) {
+                    annealing = marl::annealing_t::linear;
+                } else if(strcmp(optarg, "exponential") == 0) {
+                    annealing = marl::annealing_t::exponential;
+                } else {
+                    std::cerr << "Unknown annealing schedule: `" << optarg << "'!\n";
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'T':
+                min_temperature = std::stof(std::string{optarg});
+                break;
+            case 'z':
+                seed = std::stoull(std::string{optarg});
+                break;
+            case 'F':
+                exploit_temperature = std::stof(std::string{optarg});
+                break;
+            case 'O':
+                if(strcmp(optarg, "environment") == 0) {
+                    state_order = marl::state_order_t::environment;
+                } else if(strcmp(optarg, "bfs") == 0) {
+                    state_order = marl::state_order_t::bfs;
+                } else if(strcmp(optarg, "rcm") == 0) {
+                    state_order = marl::state_order_t::rcm;
+                } else {
+                    std::cerr << "Unknown state order: `" << optarg << "'!\n";
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'j':
+                threads = std::stoul(std::string{optarg});
+                break;
+            case 'k':
+                lockstep = std::stoul(std::string{optarg});
+                break;
             case 'r':
                 learning_rate = std::stof(std::string{optarg});
                 break;
@@ -246,6 +486,26 @@ int main(int argc, char* argv[]) {
         std::cerr << "ERROR: Initial state must be specified!\n";
         exit(EXIT_FAILURE);
     }
+    if(threads == 0) {
+        std::cerr << "ERROR: At least one thread must learn! (-j, --threads)\n";
+        exit(EXIT_FAILURE);
+    }
+    if(lockstep == 0) {
+        std::cerr << "ERROR: At least one episode must be learned at a time! (-k, --lockstep)\n";
+        exit(EXIT_FAILURE);
+    }
+    if(threads != 1 && lockstep != 1) {
+        std::cerr << "ERROR: Lockstep episodes cannot be learned on multiple threads! (-k, --lockstep)\n";
+        exit(EXIT_FAILURE);
+    }
+    if(threads != 1 && q_layout != marl::q_layout_t::dense) {
+        std::cerr << "ERROR: Only dense Q-Tables can be learned on multiple threads! (-q, --q-table)\n";
+        exit(EXIT_FAILURE);
+    }
+    if(threads != 1 && q_storage != marl::q_storage_t::fp32) {
+        std::cerr << "ERROR: Only fp32 Q-Tables can be learned on multiple threads! (-Q, --q-storage)\n";
+        exit(EXIT_FAILURE);
+    }
     switch(operation_mode) {
         case marl::operation_mode_t::multi:
             if(!set_arguments.at('S')) {
@@ -260,6 +520,14 @@ int main(int argc, char* argv[]) {
                 std::cerr << "ERROR: Exploit mode is not allowed in multi-agent environment! (-l, --learning-mode)\n";
                 exit(EXIT_FAILURE);
             }
+            if(threads != 1) {
+                std::cerr << "ERROR: Multiple threads are only supported in single-agent mode! (-j, --threads)\n";
+                exit(EXIT_FAILURE);
+            }
+            if(lockstep != 1) {
+                std::cerr << "ERROR: Lockstep episodes are only supported in single-agent mode! (-k, --lockstep)\n";
+                exit(EXIT_FAILURE);
+            }
             break;
         case marl::operation_mode_t::single:
             // nothing to do
@@ -287,18 +555,40 @@ int main(int argc, char* argv[]) {
         default:
             break;
     }
+    // Before anything large is allocated
+    marl::set_arena_policy(huge_pages, set_arguments.at('N'));
     marl::agent a;
     a.initialize(operation_mode, learning_mode);
     a.initialize(problem_path, start_state, id);
     a.set_learning_rate(learning_rate);
     a.set_temperature(temperature);
+    a.set_softmax_sampler(softmax_sampler);
+    a.set_exploration(exploration);
+    a.set_annealing(annealing, min_temperature);
+    a.set_epsilon(epsilon);
+    a.set_ucb_c(ucb_c);
+    if(set_arguments.at('z')) {
+        a.set_seed(seed);
+    }
+    a.set_exploit_temperature(exploit_temperature);
+    a.set_state_order(state_order);
+    a.set_threads(threads);
+    a.set_lockstep(lockstep);
     a.set_discount_factor(discount_factor);
     a.set_stats_file(stats_path);
+    a.set_q_layout(q_layout);
+    a.set_q_storage(q_storage);
+    a.set_storage_report(set_arguments.at('R'));
+    a.set_publish_interval(publish_interval);
     if(operation_mode == marl::operation_mode_t::multi) {
         a.connect(host, port);
     }
     a.set_iterations(episodes);
-    a.set_q_file_path(output_path);
+    if(learning_mode == marl::learning_mode_t::exploit) {
+        a.set_q_file_path(input_path);
+    } else {
+        a.set_q_file_path(output_path);
+    }
     a.start();
     a.wait();
     flog::logger::instance()->flush(std::chrono::minutes{1});
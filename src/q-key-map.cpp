@@ -0,0 +1,123 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "q-key-map.hpp"
+
+// No valid key packs to this, state ids never reach UINT32_MAX
+static const uint64_t empty_key = UINT64_MAX;
+static const size_t initial_capacity = 64;
+
+const uint32_t marl::q_key_map::npos;
+
+marl::q_key_map::q_key_map():
+    m_size{0},
+    m_mask{0} {
+}
+
+void marl::q_key_map::clear() {
+    m_keys.clear();
+    m_values.clear();
+    m_size = 0;
+    m_mask = 0;
+}
+
+uint32_t marl::q_key_map::find(uint32_t state, uint32_t action) const {
+    if(m_keys.empty()) {
+        return npos;
+    }
+    const uint64_t key = pack(state, action);
+    for(size_t i = hash(key) & m_mask;; i = (i + 1) & m_mask) {
+        if(m_keys[i] == key) {
+            return m_values[i];
+        }
+        if(m_keys[i] == empty_key) {
+            return npos;
+        }
+    }
+}
+
+void marl::q_key_map::insert(uint32_t state, uint32_t action, uint32_t value) {
+    // Keep load factor under 0.7
+    if((m_size + 1) * 10 > m_keys.size() * 7) {
+        rehash(m_keys.empty() ? initial_capacity : m_keys.size() * 2);
+    }
+    const uint64_t key = pack(state, action);
+    size_t i = hash(key) & m_mask;
+    while(m_keys[i] != empty_key && m_keys[i] != key) {
+        i = (i + 1) & m_mask;
+    }
+    if(m_keys[i] == empty_key) {
+        m_keys[i] = key;
+        ++m_size;
+    }
+    m_values[i] = value;
+}
+
+void marl::q_key_map::reserve(size_t n) {
+    size_t capacity = initial_capacity;
+    while(n * 10 > capacity * 7) {
+        capacity *= 2;
+    }
+    if(capacity > m_keys.size()) {
+        rehash(capacity);
+    }
+}
+
+size_t marl::q_key_map::size() const {
+    return m_size;
+}
+
+size_t marl::q_key_map::bytes() const {
+    return m_keys.size() * sizeof(uint64_t) + m_values.size() * sizeof(uint32_t);
+}
+
+uint64_t marl::q_key_map::pack(uint32_t state, uint32_t action) {
+    return (static_cast<uint64_t>(state) << 32) | action;
+}
+
+size_t marl::q_key_map::hash(uint64_t key) {
+    // splitmix64 finalizer
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return static_cast<size_t>(key);
+}
+
+void marl::q_key_map::rehash(size_t capacity) {
+    arena_vector<uint64_t> keys(capacity, empty_key);
+    arena_vector<uint32_t> values(capacity);
+    const size_t mask = capacity - 1;
+    for(size_t j = 0; j < m_keys.size(); ++j) {
+        if(m_keys[j] == empty_key) {
+            continue;
+        }
+        size_t i = hash(m_keys[j]) & mask;
+        while(keys[i] != empty_key) {
+            i = (i + 1) & mask;
+        }
+        keys[i] = m_keys[j];
+        values[i] = m_values[j];
+    }
+    m_keys.swap(keys);
+    m_values.swap(values);
+    m_mask = mask;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_Q_KEY_MAP_HPP
+#define MARL_Q_KEY_MAP_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "arena.hpp"
+
+namespace marl {
+
+/*
+ * Open-addressing hash map from a (state, action) pair to a 32 bit value.
+ * Keys are packed into one 64 bit word and probed linearly, so a lookup is
+ * usually a single cache line. Entries can not be erased.
+ */
+class q_key_map {
+public:
+    static const uint32_t npos = UINT32_MAX;
+
+    q_key_map();
+    void clear();
+    // Value stored for the key or npos
+    uint32_t find(uint32_t state, uint32_t action) const;
+    // Stores value for the key, overwriting the previous one
+    void insert(uint32_t state, uint32_t action, uint32_t value);
+    void reserve(size_t n);
+    size_t size() const;
+    // Memory used by the map, in bytes
+    size_t bytes() const;
+private:
+    static uint64_t pack(uint32_t state, uint32_t action);
+    static size_t hash(uint64_t key);
+    void rehash(size_t capacity);
+
+    arena_vector<uint64_t> m_keys;
+    arena_vector<uint32_t> m_values;
+    size_t m_size;
+    size_t m_mask;
+};
+
+}
+
+#endif // MARL_Q_KEY_MAP_HPP
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "q-snapshot.hpp"
+#include <algorithm>
+#include <atomic>
+
+marl::q_snapshot::q_snapshot():
+    m_epoch{0},
+    m_layout{q_layout_t::dense} {
+}
+
+void marl::q_snapshot::assign(const q_table& table, uint64_t epoch) {
+    m_epoch = epoch;
+    // The index is rebuilt if the table was, otherwise only its new rows are
+    // added
+    bool rebuilt = table.layout() != m_layout || table.rows() < m_states.size();
+    for(size_t r = 0; r < m_states.size() && !rebuilt; ++r) {
+        rebuilt = table.row_at(r).state != m_states[r];
+    }
+    if(rebuilt) {
+        m_layout = table.layout();
+        m_states.clear();
+        m_dense_rows.clear();
+        m_rows.clear();
+        if(m_layout == q_layout_t::sparse) {
+            m_rows.reserve(table.rows());
+        }
+    }
+    m_entries.resize(table.size());
+    m_offsets.resize(table.rows() + 1);
+    m_offsets[0] = 0;
+    for(size_t r = 0; r < table.rows(); ++r) {
+        const q_row row = table.row_at(r);
+        m_values.resize(std::max(m_values.size(), row.size()));
+        m_confidences.resize(std::max(m_confidences.size(), row.size()));
+        const float* values = table.values(row, m_values.data());
+        const float* confidences = table.confidences(row, m_confidences.data());
+        for(size_t n = 0; n < row.size(); ++n) {
+            q_entry_t& e = m_entries[row.offset + n];
+            e.state = row.state;
+            e.action = row.actions[n];
+            e.value = values[n];
+            e.confidence = confidences[n];
+        }
+        if(r >= m_states.size()) {
+            index_row(row.state, static_cast<uint32_t>(r));
+        }
+        m_offsets[r + 1] = row.offset + static_cast<uint32_t>(row.size());
+    }
+}
+
+void marl::q_snapshot::index_row(uint32_t state, uint32_t r) {
+    m_states.push_back(state);
+    if(m_layout == q_layout_t::sparse) {
+        m_rows.insert(state, q_key_map::npos, r);
+        return;
+    }
+    if(state >= m_dense_rows.size()) {
+        m_dense_rows.resize(state + 1, q_table::npos);
+    }
+    m_dense_rows[state] = r;
+}
+
+uint64_t marl::q_snapshot::epoch() const {
+    return m_epoch;
+}
+
+void marl::q_snapshot::read_row(uint32_t state, std::vector<q_entry_t>& out) const {
+    uint32_t r = q_table::npos;
+    if(m_layout == q_layout_t::sparse) {
+        r = m_rows.find(state, q_key_map::npos);
+    } else if(state < m_dense_rows.size()) {
+        r = m_dense_rows[state];
+    }
+    if(r == q_table::npos) {
+        out.clear();
+        return;
+    }
+    out.assign(m_entries.begin() + m_offsets[r], m_entries.begin() + m_offsets[r + 1]);
+}
+
+size_t marl::q_snapshot::size() const {
+    return m_entries.size();
+}
+
+marl::q_publisher::q_publisher():
+    m_epoch{0} {
+}
+
+void marl::q_publisher::publish(const q_table& table) {
+    // The spare was current one publish ago. If no reader still holds it, its
+    // memory is reused instead of allocating a whole new table.
+    std::shared_ptr<q_snapshot> next;
+    if(m_spare && m_spare.use_count() == 1) {
+        // Pairs with the release of the last reader's reference, so its reads
+        // happen before the snapshot is overwritten
+        std::atomic_thread_fence(std::memory_order_acquire);
+        next.swap(m_spare);
+    } else {
+        next = std::make_shared<q_snapshot>();
+    }
+    next->assign(table, m_epoch++);
+    m_spare.swap(m_latest);
+    m_latest = next;
+    std::atomic_store(&m_current, std::shared_ptr<const q_snapshot>(next));
+}
+
+void marl::q_publisher::reset() {
+    std::atomic_store(&m_current, std::shared_ptr<const q_snapshot>());
+    m_latest.reset();
+    m_spare.reset();
+    m_epoch = 0;
+}
+
+std::shared_ptr<const marl::q_snapshot> marl::q_publisher::current() const {
+    return std::atomic_load(&m_current);
+}
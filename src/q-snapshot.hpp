@@ -0,0 +1,99 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_Q_SNAPSHOT_HPP
+#define MARL_Q_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "arena.hpp"
+#include "q-key-map.hpp"
+#include "q-table.hpp"
+
+namespace marl {
+
+/*
+ * Immutable copy of a Q-Table taken at some point of learning, holding the
+ * decoded entries of every row. Snapshots are only modified by assign(),
+ * before they are published, so any number of threads may read them without
+ * synchronization.
+ *
+ * Tables only ever append rows, so assign() keeps the index from state to
+ * row of the previous copy and adds the new rows to it. A dense table is
+ * indexed by state id like the table itself, a sparse one by a hash map.
+ */
+class q_snapshot {
+public:
+    q_snapshot();
+    // Copies all rows of the table, reusing the memory of this snapshot. Only
+    // allocates for rows added since the last copy.
+    void assign(const q_table& table, uint64_t epoch);
+    // Number of snapshots published before this one
+    uint64_t epoch() const;
+    // Copies the entries of a state into out, empty if it has no row
+    void read_row(uint32_t state, std::vector<q_entry_t>& out) const;
+    size_t size() const;
+private:
+    void index_row(uint32_t state, uint32_t r);
+
+    uint64_t m_epoch;
+    q_layout_t m_layout;
+    // row -> first entry, has one extra element marking the end of last row
+    arena_vector<uint32_t> m_offsets;
+    // row -> state id, of the rows indexed below
+    arena_vector<uint32_t> m_states;
+    // state id -> row on dense layout, (state, npos) -> row on sparse layout
+    arena_vector<uint32_t> m_dense_rows;
+    q_key_map m_rows;
+    arena_vector<q_entry_t> m_entries;
+    std::vector<float> m_values;
+    std::vector<float> m_confidences;
+};
+
+/*
+ * Publishes snapshots of a Q-Table written by one thread to readers on other
+ * threads (read-copy-update). The writer copies the table into a spare
+ * snapshot and swaps it in atomically. Readers hold a reference to the
+ * snapshot they are using, so a retired one is reclaimed, or reused as the
+ * next spare, once its last reader is done with it.
+ */
+class q_publisher {
+public:
+    q_publisher();
+    // Copies the table into a snapshot and makes it the current one. Writer
+    // thread only.
+    void publish(const q_table& table);
+    // Drops all snapshots, current() returns null afterwards
+    void reset();
+    // Latest published snapshot or null, safe to call from any thread
+    std::shared_ptr<const q_snapshot> current() const;
+private:
+    std::shared_ptr<const q_snapshot> m_current;
+    // Same snapshot as current, and the one published before it
+    std::shared_ptr<q_snapshot> m_latest;
+    std::shared_ptr<q_snapshot> m_spare;
+    uint64_t m_epoch;
+};
+
+}
+
+#endif // MARL_Q_SNAPSHOT_HPP
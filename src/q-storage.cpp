@@ -0,0 +1,203 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "q-storage.hpp"
+#include <algorithm>
+#include <cmath>
+
+const size_t marl::q_column::int8_block;
+
+uint16_t marl::float_to_half(float f) {
+#if defined(__F16C__)
+    return _cvtss_sh(f, 0);
+#else
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const uint32_t magnitude = bits & 0x7fffffff;
+    if(magnitude >= 0x7f800000) {
+        // Infinity stays infinity, NaN stays a quiet NaN
+        return sign | (magnitude > 0x7f800000 ? 0x7e00 : 0x7c00);
+    }
+    if(magnitude >= 0x477ff000) {
+        // Rounds to a value above the largest half
+        return sign | 0x7c00;
+    }
+    if(magnitude < 0x38800000) {
+        // Subnormal half or zero
+        if(magnitude < 0x33000000) {
+            return sign;
+        }
+        const uint32_t exponent = magnitude >> 23;
+        const uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+        const uint32_t shift = 126 - exponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if(rest > halfway || (rest == halfway && (half & 1))) {
+            ++half;
+        }
+        return sign | static_cast<uint16_t>(half);
+    }
+    // Normal half, round mantissa to nearest even
+    uint32_t half = ((magnitude >> 13) - (112 << 10));
+    const uint32_t rest = magnitude & 0x1fff;
+    if(rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        ++half;
+    }
+    return sign | static_cast<uint16_t>(half);
+#endif
+}
+
+uint16_t marl::float_to_bfloat16(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    if((bits & 0x7fffffff) > 0x7f800000) {
+        // Keep NaN a NaN after truncation
+        return static_cast<uint16_t>((bits >> 16) | 0x40);
+    }
+    // Round to nearest even
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+marl::q_column::q_column():
+    m_storage{q_storage_t::fp32},
+    m_size{0} {
+}
+
+void marl::q_column::reset(q_storage_t storage) {
+    m_storage = storage;
+    m_size = 0;
+    m_fp32.clear();
+    m_16.clear();
+    m_int8.clear();
+    m_scales.clear();
+}
+
+void marl::q_column::resize(size_t n) {
+    m_size = n;
+    switch(m_storage) {
+        case q_storage_t::fp32:
+            m_fp32.resize(n, 0.0f);
+            break;
+        case q_storage_t::fp16:
+        case q_storage_t::bf16:
+            // Zero is all bits clear in both encodings
+            m_16.resize(n, 0);
+            break;
+        case q_storage_t::int8:
+            m_int8.resize(n, 0);
+            m_scales.resize((n + int8_block - 1) / int8_block, 0.0f);
+            break;
+    }
+}
+
+size_t marl::q_column::size() const {
+    return m_size;
+}
+
+marl::q_storage_t marl::q_column::storage() const {
+    return m_storage;
+}
+
+size_t marl::q_column::bytes() const {
+    return m_fp32.size() * sizeof(float)
+           + m_16.size() * sizeof(uint16_t)
+           + m_int8.size() * sizeof(int8_t)
+           + m_scales.size() * sizeof(float);
+}
+
+namespace {
+
+// Stores of the column, relaxed atomics when other threads read it
+template<bool Shared, typename T>
+inline void put(T& slot, T v) {
+    if(Shared) {
+        marl::relaxed_store(slot, v);
+    } else {
+        slot = v;
+    }
+}
+
+}
+
+bool marl::q_column::set(size_t i, float v) {
+    return store<false>(i, v);
+}
+
+bool marl::q_column::set_shared(size_t i, float v) {
+    return store<true>(i, v);
+}
+
+template<bool Shared>
+bool marl::q_column::store(size_t i, float v) {
+    switch(m_storage) {
+        case q_storage_t::fp32:
+            put<Shared>(m_fp32[i], v);
+            break;
+        case q_storage_t::fp16:
+            put<Shared>(m_16[i], float_to_half(v));
+            break;
+        case q_storage_t::bf16:
+            put<Shared>(m_16[i], float_to_bfloat16(v));
+            break;
+        case q_storage_t::int8: {
+            const size_t block = i / int8_block;
+            const float magnitude = std::fabs(v);
+            bool rescaled = false;
+            if(magnitude > 127.0f * m_scales[block]) {
+                rescale<Shared>(block, magnitude);
+                rescaled = true;
+            }
+            const float scale = m_scales[block];
+            const int8_t q = scale > 0.0f
+                             ? static_cast<int8_t>(std::lround(v / scale)) : 0;
+            put<Shared>(m_int8[i], q);
+            return rescaled;
+        }
+    }
+    return false;
+}
+
+const float* marl::q_column::load(size_t first, size_t n, float* out) const {
+    if(m_storage == q_storage_t::fp32) {
+        return m_fp32.data() + first;
+    }
+    for(size_t i = 0; i < n; ++i) {
+        out[i] = get(first + i);
+    }
+    return out;
+}
+
+template<bool Shared>
+void marl::q_column::rescale(size_t block, float magnitude) {
+    // Leave some headroom so a slowly growing value does not requantize the
+    // block on every write
+    const float old_scale = m_scales[block];
+    const float new_scale = magnitude * 1.25f / 127.0f;
+    const size_t first = block * int8_block;
+    const size_t last = std::min(first + int8_block, m_size);
+    for(size_t i = first; i < last; ++i) {
+        put<Shared>(m_int8[i],
+                    static_cast<int8_t>(std::lround(m_int8[i] * old_scale / new_scale)));
+    }
+    put<Shared>(m_scales[block], new_scale);
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_Q_STORAGE_HPP
+#define MARL_Q_STORAGE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <cstring>
+#include "arena.hpp"
+#include "locks.hpp"
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace marl {
+
+enum class q_storage_t {
+    fp32,       // 4 bytes per value, exact
+    fp16,       // 2 bytes per value, IEEE half precision
+    bf16,       // 2 bytes per value, upper half of an IEEE single
+    int8        // 1 byte per value plus one float scale per block of slots
+};
+
+uint16_t float_to_half(float f);
+uint16_t float_to_bfloat16(float f);
+
+inline float half_to_float(uint16_t h) {
+#if defined(__F16C__)
+    return _cvtsh_ss(h);
+#else
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t bits;
+    if(exponent == 0x1f) {
+        // Infinity or NaN
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if(exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if(mantissa == 0) {
+        bits = sign;
+    } else {
+        // Subnormal half, normalize it
+        exponent = 113;
+        while(!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+#endif
+}
+
+inline float bfloat16_to_float(uint16_t b) {
+    const uint32_t bits = static_cast<uint32_t>(b) << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/*
+ * A column of floats stored in one of q_storage_t encodings. Values are
+ * widened back to float on read. On int8 storage every block of
+ * `int8_block' consecutive slots shares a scale that grows when a larger
+ * magnitude is written into the block.
+ */
+class q_column {
+public:
+    static const size_t int8_block = 16;
+
+    q_column();
+    // Drops all values and switches to the given encoding
+    void reset(q_storage_t storage);
+    // Grows or shrinks the column, new slots are zero
+    void resize(size_t n);
+    size_t size() const;
+    q_storage_t storage() const;
+    // Bytes used by the encoded values, including int8 scales
+    size_t bytes() const;
+    float get(size_t i) const;
+    // Returns true if other slots of the block were requantized to make room
+    // for the value, which only happens on int8 storage
+    bool set(size_t i, float v);
+    // Same as get() and set() on a column other threads read under a seqlock
+    // while it is written. Slots and scales are accessed with relaxed atomics.
+    float get_shared(size_t i) const;
+    bool set_shared(size_t i, float v);
+    // Pointer to the values when they are stored as plain floats, otherwise
+    // decodes [first, first + n) into out and returns out
+    const float* load(size_t first, size_t n, float* out) const;
+private:
+    template<bool Shared>
+    bool store(size_t i, float v);
+    template<bool Shared>
+    void rescale(size_t block, float magnitude);
+
+    q_storage_t m_storage;
+    size_t m_size;
+    arena_vector<float> m_fp32;
+    arena_vector<uint16_t> m_16;
+    arena_vector<int8_t> m_int8;
+    arena_vector<float> m_scales;
+};
+
+inline float q_column::get(size_t i) const {
+    switch(m_storage) {
+        case q_storage_t::fp32:
+            return m_fp32[i];
+        case q_storage_t::fp16:
+            return half_to_float(m_16[i]);
+        case q_storage_t::bf16:
+            return bfloat16_to_float(m_16[i]);
+        case q_storage_t::int8:
+            return m_int8[i] * m_scales[i / int8_block];
+    }
+    return 0.0f;
+}
+
+inline float q_column::get_shared(size_t i) const {
+    switch(m_storage) {
+        case q_storage_t::fp32:
+            return relaxed_load(m_fp32[i]);
+        case q_storage_t::fp16:
+            return half_to_float(relaxed_load(m_16[i]));
+        case q_storage_t::bf16:
+            return bfloat16_to_float(relaxed_load(m_16[i]));
+        case q_storage_t::int8:
+            return relaxed_load(m_int8[i]) * relaxed_load(m_scales[i / int8_block]);
+    }
+    return 0.0f;
+}
+
+}
+
+#endif // MARL_Q_STORAGE_HPP
@@ -19,3 +19,386 @@
  */
 
 #include "q-table.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <mutex>
+#include "kernels.hpp"
+#include <marl-protocols/state.hpp>
+#include <marl-protocols/action.hpp>
+
+const uint32_t marl::q_table::npos;
+const size_t marl::q_table::seqlocks;
+
+marl::q_table::q_table():
+    m_layout{q_layout_t::dense},
+    m_concurrent{true},
+    m_kernels{&row_kernels_for(0)} {
+}
+
+void marl::q_table::initialize(const std::vector<state*>& states,
+                               q_layout_t layout, q_storage_t storage) {
+    std::lock_guard<rw_lock> lock(m_layout_lock);
+    reset();
+    m_layout = layout;
+    m_values.reset(storage);
+    m_confidences.reset(confidence_storage(storage));
+    size_t width = 0;
+    for(const state* s : states) {
+        width = std::max(width, s->actions().size());
+    }
+    m_kernels = &row_kernels_for(width);
+    if(m_layout == q_layout_t::sparse) {
+        m_offsets.push_back(0);
+        return;
+    }
+    m_offsets.reserve(states.size() + 1);
+    m_states.reserve(states.size());
+    m_max.assign(states.size(), 0.0f);
+    m_argmax.assign(states.size(), 0);
+    for(const state* s : states) {
+        if(s->id() >= m_rows.size()) {
+            m_rows.resize(s->id() + 1, npos);
+        }
+        m_rows[s->id()] = static_cast<uint32_t>(m_states.size());
+        m_states.push_back(s->id());
+        m_offsets.push_back(static_cast<uint32_t>(m_actions.size()));
+        for(const action* a : s->actions()) {
+            m_actions.push_back(a->id());
+        }
+        m_scratch.resize(std::max(m_scratch.size(), s->actions().size()));
+    }
+    m_offsets.push_back(static_cast<uint32_t>(m_actions.size()));
+    m_values.resize(m_actions.size());
+    m_confidences.resize(m_actions.size());
+}
+
+void marl::q_table::clear() {
+    std::lock_guard<rw_lock> lock(m_layout_lock);
+    reset();
+}
+
+void marl::q_table::reset() {
+    m_offsets.clear();
+    m_states.clear();
+    m_max.clear();
+    m_argmax.clear();
+    m_scratch.clear();
+    m_rows.clear();
+    m_actions.clear();
+    m_values.resize(0);
+    m_confidences.resize(0);
+    m_keys.clear();
+}
+
+marl::q_layout_t marl::q_table::layout() const {
+    return m_layout;
+}
+
+marl::q_storage_t marl::q_table::storage() const {
+    return m_values.storage();
+}
+
+marl::q_row marl::q_table::materialize(const state* s) {
+    const uint32_t r = row_index(s->id());
+    if(r != npos) {
+        return row_at(r);
+    }
+    // Only reachable on sparse layout, dense tables have a row for each state
+    std::unique_lock<rw_lock> lock(m_layout_lock, std::defer_lock);
+    if(m_concurrent) {
+        lock.lock();
+    }
+    m_keys.insert(s->id(), npos, static_cast<uint32_t>(m_states.size()));
+    m_states.push_back(s->id());
+    m_max.push_back(0.0f);
+    m_argmax.push_back(0);
+    for(const action* a : s->actions()) {
+        m_keys.insert(s->id(), a->id(), static_cast<uint32_t>(m_actions.size()));
+        m_actions.push_back(a->id());
+    }
+    m_offsets.push_back(static_cast<uint32_t>(m_actions.size()));
+    m_values.resize(m_actions.size());
+    m_confidences.resize(m_actions.size());
+    m_scratch.resize(std::max(m_scratch.size(), s->actions().size()));
+    return row_at(m_states.size() - 1);
+}
+
+uint32_t marl::q_table::row_index(uint32_t state) const {
+    if(m_layout == q_layout_t::sparse) {
+        return m_keys.find(state, npos);
+    }
+    if(state >= m_rows.size()) {
+        return npos;
+    }
+    return m_rows[state];
+}
+
+marl::q_row marl::q_table::row(uint32_t state) const {
+    const uint32_t r = row_index(state);
+    if(r == npos) {
+        return q_row{state, npos, 0, 0, nullptr};
+    }
+    return row_at(r);
+}
+
+marl::q_row marl::q_table::row_at(size_t r) const {
+    const uint32_t first = m_offsets[r];
+    return q_row{m_states[r], static_cast<uint32_t>(r),
+                 first, m_offsets[r + 1] - first,
+                 m_actions.data() + first};
+}
+
+size_t marl::q_table::rows() const {
+    return m_states.size();
+}
+
+uint32_t marl::q_table::find(uint32_t state, uint32_t action) const {
+    if(m_layout == q_layout_t::sparse) {
+        return m_keys.find(state, action);
+    }
+    const q_row r = row(state);
+    for(size_t i = 0; i < r.size(); ++i) {
+        if(r.actions[i] == action) {
+            return static_cast<uint32_t>(r.offset + i);
+        }
+    }
+    return npos;
+}
+
+float marl::q_table::value(uint32_t slot) const {
+    assert(slot < size());
+    return m_values.get(slot);
+}
+
+float marl::q_table::confidence(uint32_t slot) const {
+    assert(slot < size());
+    return m_confidences.get(slot);
+}
+
+void marl::q_table::set_value(const q_row& r, size_t n, float value) {
+    assert(owns(r, n));
+    const uint32_t slot = static_cast<uint32_t>(r.offset + n);
+    // Requantizing int8 storage stays within the block, and so in one seqlock
+    seqlock& lock = slot_lock(slot);
+    bool rescaled;
+    if(m_concurrent) {
+        lock.write_begin();
+        rescaled = m_values.set_shared(slot, value);
+        lock.write_end();
+    } else {
+        rescaled = m_values.set(slot, value);
+    }
+    value_changed(r, n, rescaled);
+}
+
+void marl::q_table::set_values(const q_row& r, const float* values) {
+    for(size_t n = 0; n < r.size(); ++n) {
+        set_value(r, n, values[n]);
+    }
+}
+
+void marl::q_table::set_entry(const q_row& r, size_t n, float value, float confidence) {
+    assert(owns(r, n));
+    const uint32_t slot = static_cast<uint32_t>(r.offset + n);
+    seqlock& lock = slot_lock(slot);
+    bool rescaled;
+    if(m_concurrent) {
+        lock.write_begin();
+        rescaled = m_values.set_shared(slot, value);
+        m_confidences.set_shared(slot, confidence);
+        lock.write_end();
+    } else {
+        rescaled = m_values.set(slot, value);
+        m_confidences.set(slot, confidence);
+    }
+    value_changed(r, n, rescaled);
+}
+
+void marl::q_table::value_changed(const q_row& r, size_t n, bool rescaled) {
+    const uint32_t slot = static_cast<uint32_t>(r.offset + n);
+    if(rescaled) {
+        // Neighbour slots changed too, rescan all rows sharing the block
+        const size_t first = slot - slot % q_column::int8_block;
+        const size_t last = std::min(first + q_column::int8_block, size());
+        auto begin = std::upper_bound(m_offsets.begin(), m_offsets.end(), first) - 1;
+        auto end = std::lower_bound(begin, m_offsets.end(), last);
+        for(auto it = begin; it != end; ++it) {
+            update_max(static_cast<uint32_t>(it - m_offsets.begin()));
+        }
+        return;
+    }
+    // Compare what was actually stored, it may have lost precision
+    const float stored = m_values.get(slot);
+    float& max = m_max[r.index];
+    uint32_t& argmax = m_argmax[r.index];
+    if(stored > max || (stored == max && n < argmax)) {
+        max = stored;
+        argmax = static_cast<uint32_t>(n);
+    } else if(n == argmax && stored < max) {
+        update_max(r.index);
+    }
+}
+
+bool marl::q_table::owns(const q_row& r, size_t n) const {
+    return r.index < rows() && m_offsets[r.index] == r.offset && n < r.size();
+}
+
+void marl::q_table::update_max(uint32_t r) {
+    const uint32_t first = m_offsets[r];
+    const size_t count = m_offsets[r + 1] - first;
+    if(count == 0) {
+        return;
+    }
+    const float* values = m_values.load(first, count, m_scratch.data());
+    m_argmax[r] = static_cast<uint32_t>(m_kernels->argmax(values, count));
+    m_max[r] = values[m_argmax[r]];
+}
+
+void marl::q_table::set_confidence(uint32_t slot, float confidence) {
+    assert(slot < size());
+    seqlock& lock = slot_lock(slot);
+    if(m_concurrent) {
+        lock.write_begin();
+        m_confidences.set_shared(slot, confidence);
+        lock.write_end();
+    } else {
+        m_confidences.set(slot, confidence);
+    }
+}
+
+void marl::q_table::set_concurrent(bool concurrent) {
+    m_concurrent = concurrent;
+}
+
+void marl::q_table::read_row(uint32_t state, std::vector<q_entry_t>& out) const {
+    shared_guard guard(m_layout_lock);
+    const q_row r = row(state);
+    out.resize(r.size());
+    if(r.empty()) {
+        return;
+    }
+    // A row longer than all seqlocks together checks some of them twice
+    const size_t first = r.offset / q_column::int8_block;
+    const size_t count = std::min(seqlocks,
+                                  (r.offset + r.size() - 1) / q_column::int8_block - first + 1);
+    uint32_t sequences[seqlocks];
+    bool torn = true;
+    while(torn) {
+        for(size_t i = 0; i < count; ++i) {
+            sequences[i] = m_seqlocks[(first + i) % seqlocks].read_begin();
+        }
+        for(size_t n = 0; n < r.size(); ++n) {
+            q_entry_t& e = out[n];
+            e.state = r.state;
+            e.action = r.actions[n];
+            e.value = m_values.get_shared(r.offset + n);
+            e.confidence = m_confidences.get_shared(r.offset + n);
+        }
+        torn = false;
+        for(size_t i = 0; i < count && !torn; ++i) {
+            torn = m_seqlocks[(first + i) % seqlocks].read_retry(sequences[i]);
+        }
+    }
+}
+
+marl::seqlock& marl::q_table::slot_lock(uint32_t slot) {
+    return m_seqlocks[(slot / q_column::int8_block) % seqlocks];
+}
+
+const float* marl::q_table::values(const q_row& r, float* scratch) const {
+    return m_values.load(r.offset, r.size(), scratch);
+}
+
+float marl::q_table::row_max(const q_row& r) const {
+    return r.index == npos ? 0.0f : m_max[r.index];
+}
+
+uint32_t marl::q_table::row_argmax(const q_row& r) const {
+    return r.index == npos ? 0 : m_argmax[r.index];
+}
+
+const float* marl::q_table::confidences(const q_row& r, float* scratch) const {
+    return m_confidences.load(r.offset, r.size(), scratch);
+}
+
+size_t marl::q_table::bytes() const {
+    return m_offsets.size() * sizeof(uint32_t)
+           + m_states.size() * sizeof(uint32_t)
+           + m_rows.size() * sizeof(uint32_t)
+           + m_keys.bytes()
+           + m_actions.size() * sizeof(uint32_t)
+           + m_values.bytes()
+           + m_confidences.bytes();
+}
+
+marl::q_storage_stats marl::q_table::evaluate(q_storage_t storage) const {
+    q_column values;
+    q_column confidences;
+    // Confidences encoded like the values, which the table does not do, to
+    // show what that would cost
+    q_column compact_confidences;
+    values.reset(storage);
+    values.resize(size());
+    confidences.reset(confidence_storage(storage));
+    confidences.resize(size());
+    compact_confidences.reset(storage);
+    compact_confidences.resize(size());
+    for(size_t i = 0; i < size(); ++i) {
+        values.set(i, m_values.get(i));
+        confidences.set(i, m_confidences.get(i));
+        compact_confidences.set(i, m_confidences.get(i));
+    }
+    q_storage_stats stats;
+    stats.storage = storage;
+    stats.bytes = values.bytes() + confidences.bytes();
+    stats.max_error = 0.0f;
+    stats.max_confidence_error = 0.0f;
+    double total_error = 0.0;
+    double total_confidence_error = 0.0;
+    for(size_t i = 0; i < size(); ++i) {
+        const float error = std::fabs(values.get(i) - m_values.get(i));
+        stats.max_error = std::max(stats.max_error, error);
+        total_error += error;
+        const float confidence_error = std::fabs(compact_confidences.get(i)
+                                                 - m_confidences.get(i));
+        stats.max_confidence_error = std::max(stats.max_confidence_error, confidence_error);
+        total_confidence_error += confidence_error;
+    }
+    stats.mean_error = size() ? static_cast<float>(total_error / size()) : 0.0f;
+    stats.mean_confidence_error = size() ?
+                                  static_cast<float>(total_confidence_error / size()) : 0.0f;
+    // Greedy action of every non-empty row before and after conversion
+    size_t kept = 0;
+    size_t nonempty = 0;
+    std::vector<float> original;
+    std::vector<float> converted;
+    for(size_t r = 0; r < rows(); ++r) {
+        const q_row row = row_at(r);
+        if(row.empty()) {
+            continue;
+        }
+        original.resize(row.size());
+        converted.resize(row.size());
+        const float* a = m_values.load(row.offset, row.size(), original.data());
+        const float* b = values.load(row.offset, row.size(), converted.data());
+        if(argmax(a, row.size()) == argmax(b, row.size())) {
+            ++kept;
+        }
+        ++nonempty;
+    }
+    stats.agreement = nonempty ? static_cast<float>(kept) / nonempty : 1.0f;
+    return stats;
+}
+
+marl::q_storage_t marl::q_table::confidence_storage(q_storage_t) {
+    return q_storage_t::fp32;
+}
+
+size_t marl::q_table::size() const {
+    return m_actions.size();
+}
+
+bool marl::q_table::empty() const {
+    return m_actions.empty();
+}
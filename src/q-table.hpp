@@ -18,10 +18,20 @@
  * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#ifndef MARL_Q_TABLE_HPP
+#define MARL_Q_TABLE_HPP
+
 #include <cstdint>
+#include <cstddef>
+#include <array>
 #include <vector>
 #include <map>
 #include <utility>
+#include "arena.hpp"
+#include "kernels.hpp"
+#include "q-key-map.hpp"
+#include "q-storage.hpp"
+#include "locks.hpp"
 
 namespace marl {
 struct q_entry_t {
@@ -34,4 +44,166 @@ struct q_entry_t {
 typedef std::pair<uint32_t /*state*/, uint32_t/*action*/> q_key;
 typedef std::map<uint32_t, uint32_t> state_stats_t;
 
+class state;
+
+/*
+ * All actions of one state as a view into the Q-Table. The n-th action of a
+ * state lives in slot `offset + n'.
+ */
+struct q_row {
+    uint32_t state;
+    uint32_t index;             // row number, npos if the state has no row
+    uint32_t offset;            // slot of the first action
+    size_t count;
+    const uint32_t* actions;
+
+    size_t size() const {
+        return count;
+    }
+    bool empty() const {
+        return count == 0;
+    }
+};
+
+// Accuracy of a Q-Table if it was stored with another encoding, measured
+// against its values as currently stored
+struct q_storage_stats {
+    q_storage_t storage;
+    size_t bytes;               // values and confidences columns
+    float max_error;            // of values, absolute
+    float mean_error;
+    // Of confidences if they were encoded like the values, which the table
+    // does not do (see q_table::confidence_storage()), absolute
+    float max_confidence_error;
+    float mean_confidence_error;
+    float agreement;            // share of rows whose greedy action is kept
+};
+
+enum class q_layout_t {
+    dense,      // One row per state, allocated up front
+    sparse      // Rows allocated on first write, found through a hash map
+};
+
+/*
+ * Q-Table stored as per-state rows (CSR layout): an offsets array indexed by
+ * row plus the slots of all rows packed back to back. Slots are kept as a
+ * structure of arrays, so reductions over the values of a row (max, softmax,
+ * consensus weighting) only touch the value column. Values may be kept in a
+ * compact encoding (see q_storage_t), in which case they are widened to float
+ * on every read. Confidences always stay fp32, see confidence_storage().
+ *
+ * On sparse layout a row is appended only when materialize() is called for
+ * its state, and states and slots are looked up through a q_key_map. Rows
+ * that were never materialized read as empty, i.e. all of their values and
+ * confidences are zero.
+ *
+ * The table keeps the maximum value of every row and its position. Writing a
+ * value that is not lower updates them in O(1), they are only recomputed from
+ * the row when the current maximum decreases.
+ *
+ * One thread, the learner, may modify the table while others call
+ * read_row(). Slots are guarded by a fixed set of seqlocks, one per block of
+ * slots modulo their count, so readers retry instead of blocking the writer.
+ * Changes to the layout of the table (initialize(), clear() and appending rows
+ * in materialize()) take a reader/writer lock which read_row() shares. All
+ * other members are for the writing thread only. Without concurrent readers,
+ * e.g. when they are served from a q_snapshot instead, writes take no locks.
+ */
+class q_table {
+public:
+    static const uint32_t npos = UINT32_MAX;
+
+    q_table();
+    // Builds one zero-initialized row per state on dense layout
+    void initialize(const std::vector<state*>& states,
+                    q_layout_t layout = q_layout_t::dense,
+                    q_storage_t storage = q_storage_t::fp32);
+    void clear();
+    q_layout_t layout() const;
+    q_storage_t storage() const;
+    // Row of the state, appending a zero-initialized one if missing. May move
+    // the columns, so rows obtained before are invalidated.
+    q_row materialize(const state* s);
+    q_row row(uint32_t state) const;
+    q_row row_at(size_t r) const;
+    size_t rows() const;
+    // Slot of a (state, action) pair or npos
+    uint32_t find(uint32_t state, uint32_t action) const;
+    float value(uint32_t slot) const;
+    float confidence(uint32_t slot) const;
+    // Sets the value of the n-th action of a row
+    void set_value(const q_row& r, size_t n, float value);
+    // Sets the values of all actions of a row, leaving other rows alone
+    void set_values(const q_row& r, const float* values);
+    void set_confidence(uint32_t slot, float confidence);
+    // Sets value and confidence together, readers see both or neither
+    void set_entry(const q_row& r, size_t n, float value, float confidence);
+    // Values or confidences of a row as floats. Points into the table on fp32
+    // storage, otherwise the row is decoded into scratch, which must hold
+    // row.size() floats.
+    const float* values(const q_row& r, float* scratch) const;
+    const float* confidences(const q_row& r, float* scratch) const;
+    // Highest value of a row and the position of its first occurrence. Rows
+    // which are empty have a maximum of zero at position zero.
+    float row_max(const q_row& r) const;
+    uint32_t row_argmax(const q_row& r) const;
+    // Copies the entries of a state into out, safe to call from any thread
+    void read_row(uint32_t state, std::vector<q_entry_t>& out) const;
+    // Whether read_row() may be called while the table is written, true by
+    // default. Otherwise writes skip the seqlocks.
+    void set_concurrent(bool);
+    // Memory used by the table, in bytes
+    size_t bytes() const;
+    // Compares values and confidences with what they would be on the given
+    // storage. The reference is the table as stored: on compact storage it
+    // was already rounded while learning, which the errors do not include.
+    q_storage_stats evaluate(q_storage_t storage) const;
+    // Encoding of the confidence column when values are stored as given.
+    // Learners add increments of 0.001 which compact encodings round away
+    // once a confidence grows (fp16 stops at 4, int8 well below 1), so
+    // confidences are kept as fp32 on every storage.
+    static q_storage_t confidence_storage(q_storage_t storage);
+    size_t size() const;
+    bool empty() const;
+private:
+    static const size_t seqlocks = 256;
+
+    void reset();
+    uint32_t row_index(uint32_t state) const;
+    // Whether the n-th action of a row is a slot of this table, the check
+    // of debug builds on writes
+    bool owns(const q_row& r, size_t n) const;
+    // Updates the cached maximum after the n-th value of a row was written
+    void value_changed(const q_row& r, size_t n, bool rescaled);
+    void update_max(uint32_t r);
+    seqlock& slot_lock(uint32_t slot);
+
+    q_layout_t m_layout;
+    bool m_concurrent;
+    // Picked by initialize() for the widest row of the problem
+    const row_kernels* m_kernels;
+    // row -> first slot, has one extra element marking the end of last row
+    arena_vector<uint32_t> m_offsets;
+    // row -> state id
+    arena_vector<uint32_t> m_states;
+    // row -> cached maximum value and its position
+    arena_vector<float> m_max;
+    arena_vector<uint32_t> m_argmax;
+    // Decoded values of the row being rescanned for its maximum
+    std::vector<float> m_scratch;
+    // state id -> row, on dense layout
+    arena_vector<uint32_t> m_rows;
+    // (state, npos) -> row and (state, action) -> slot, on sparse layout
+    q_key_map m_keys;
+    // slot columns
+    arena_vector<uint32_t> m_actions;
+    q_column m_values;
+    q_column m_confidences;
+    // Block of slots -> seqlock, see seqlocks
+    std::array<seqlock, seqlocks> m_seqlocks;
+    mutable rw_lock m_layout_lock;
+};
+
 }
+
+#endif // MARL_Q_TABLE_HPP
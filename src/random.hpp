@@ -0,0 +1,169 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_RANDOM_HPP
+#define MARL_RANDOM_HPP
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace marl {
+
+/*
+ * xoshiro256** generator by Blackman and Vigna: 32 bytes of state and a few
+ * shifts per number, passing BigCrush. Satisfies UniformRandomBitGenerator,
+ * so it works with the standard distributions too.
+ *
+ * Streams of the same seed are 2^128 numbers apart (see jump()), so agents or
+ * threads seeded with a common seed and their own stream never overlap.
+ * long_jump() splits a stream further, e.g. among the threads of one agent.
+ */
+class xoshiro256 {
+public:
+    typedef uint64_t result_type;
+
+    explicit xoshiro256(uint64_t seed = 0, uint64_t stream = 0) {
+        this->seed(seed, stream);
+    }
+    // Expands seed with splitmix64, as recommended for xoshiro, then jumps to
+    // the start of the given stream
+    void seed(uint64_t seed, uint64_t stream = 0) {
+        for(int i = 0; i < 4; ++i) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            m_s[i] = z ^ (z >> 31);
+        }
+        jump(stream);
+    }
+    result_type operator()() {
+        const uint64_t result = rotl(m_s[1] * 5, 7) * 9;
+        const uint64_t t = m_s[1] << 17;
+        m_s[2] ^= m_s[0];
+        m_s[3] ^= m_s[1];
+        m_s[1] ^= m_s[2];
+        m_s[0] ^= m_s[3];
+        m_s[2] ^= t;
+        m_s[3] = rotl(m_s[3], 45);
+        return result;
+    }
+    // Advances the generator by 2^128 numbers
+    void jump() {
+        static const uint64_t polynomial[] = {
+            0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+            0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+        };
+        advance(polynomial);
+    }
+    // Advances the generator by n * 2^128 numbers, i.e. n streams. The state
+    // is linear over GF(2), jumps are applied as the powers of two of the
+    // matrix of jump(), so any n takes at most 64 matrix squarings.
+    void jump(uint64_t n) {
+        if(n <= 1) {
+            if(n == 1) {
+                jump();
+            }
+            return;
+        }
+        // Column j is the image of state bit j under the current power
+        std::vector<uint64_t> matrix(256 * 4);
+        for(int j = 0; j < 256; ++j) {
+            xoshiro256 basis;
+            for(int i = 0; i < 4; ++i) {
+                basis.m_s[i] = i == j / 64 ? 1ULL << (j % 64) : 0;
+            }
+            basis.jump();
+            for(int i = 0; i < 4; ++i) {
+                matrix[4 * j + i] = basis.m_s[i];
+            }
+        }
+        std::vector<uint64_t> squared(256 * 4);
+        for(;;) {
+            if(n & 1) {
+                multiply(matrix, m_s, m_s);
+            }
+            n >>= 1;
+            if(n == 0) {
+                break;
+            }
+            for(int j = 0; j < 256; ++j) {
+                multiply(matrix, &matrix[4 * j], &squared[4 * j]);
+            }
+            matrix.swap(squared);
+        }
+    }
+    // Advances the generator by 2^192 numbers, i.e. 2^64 streams
+    void long_jump() {
+        static const uint64_t polynomial[] = {
+            0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+            0x77710069854ee241ULL, 0x39109bb02acbe635ULL
+        };
+        advance(polynomial);
+    }
+    static constexpr result_type min() {
+        return 0;
+    }
+    static constexpr result_type max() {
+        return std::numeric_limits<result_type>::max();
+    }
+private:
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+    void advance(const uint64_t (&polynomial)[4]) {
+        uint64_t s[4] = {0, 0, 0, 0};
+        for(uint64_t word : polynomial) {
+            for(int b = 0; b < 64; ++b) {
+                if(word & (1ULL << b)) {
+                    for(int i = 0; i < 4; ++i) {
+                        s[i] ^= m_s[i];
+                    }
+                }
+                (*this)();
+            }
+        }
+        for(int i = 0; i < 4; ++i) {
+            m_s[i] = s[i];
+        }
+    }
+    // out = matrix * in over GF(2), in and out may alias
+    static void multiply(const std::vector<uint64_t>& matrix, const uint64_t* in,
+                         uint64_t* out) {
+        uint64_t s[4] = {0, 0, 0, 0};
+        for(int j = 0; j < 256; ++j) {
+            if(in[j / 64] & (1ULL << (j % 64))) {
+                for(int i = 0; i < 4; ++i) {
+                    s[i] ^= matrix[4 * j + i];
+                }
+            }
+        }
+        for(int i = 0; i < 4; ++i) {
+            out[i] = s[i];
+        }
+    }
+
+    uint64_t m_s[4];
+};
+
+}
+
+#endif // MARL_RANDOM_HPP
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "state-order.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <marl-protocols/state.hpp>
+#include <marl-protocols/action.hpp>
+
+namespace {
+
+// Undirected transition graph of the states in CSR layout
+struct graph {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> neighbours;
+
+    uint32_t degree(uint32_t s) const {
+        return offsets[s + 1] - offsets[s];
+    }
+};
+
+graph build_graph(const std::vector<marl::state*>& states) {
+    std::unordered_map<const marl::state*, uint32_t> index;
+    index.reserve(states.size());
+    for(const marl::state* s : states) {
+        index.emplace(s, static_cast<uint32_t>(index.size()));
+    }
+    // Both directions of every edge, without self loops
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    for(uint32_t from = 0; from < states.size(); ++from) {
+        for(const marl::action* a : states[from]->actions()) {
+            for(const marl::transition* t : a->transitions()) {
+                auto found = index.find(t->to());
+                if(found == index.end() || found->second == from) {
+                    continue;
+                }
+                edges.emplace_back(from, found->second);
+                edges.emplace_back(found->second, from);
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    graph g;
+    g.offsets.assign(states.size() + 1, 0);
+    g.neighbours.reserve(edges.size());
+    for(const auto& e : edges) {
+        g.offsets[e.first + 1]++;
+        g.neighbours.push_back(e.second);
+    }
+    for(size_t s = 0; s < states.size(); ++s) {
+        g.offsets[s + 1] += g.offsets[s];
+    }
+    return g;
+}
+
+}
+
+std::vector<marl::state*> marl::order_states(const std::vector<state*>& states,
+                                             state_order_t order) {
+    if(order == state_order_t::environment) {
+        return states;
+    }
+    const graph g = build_graph(states);
+    const bool rcm = order == state_order_t::rcm;
+    // Component roots, tried in this order
+    std::vector<uint32_t> roots(states.size());
+    for(uint32_t s = 0; s < roots.size(); ++s) {
+        roots[s] = s;
+    }
+    if(rcm) {
+        std::stable_sort(roots.begin(), roots.end(), [&g](uint32_t a, uint32_t b) {
+            return g.degree(a) < g.degree(b);
+        });
+    }
+    std::vector<uint32_t> visit;
+    visit.reserve(states.size());
+    std::vector<bool> visited(states.size(), false);
+    for(uint32_t root : roots) {
+        if(visited[root]) {
+            continue;
+        }
+        visited[root] = true;
+        // visit doubles as the queue, from head on
+        size_t head = visit.size();
+        visit.push_back(root);
+        while(head < visit.size()) {
+            const uint32_t s = visit[head++];
+            const size_t first = visit.size();
+            for(uint32_t i = g.offsets[s]; i < g.offsets[s + 1]; ++i) {
+                const uint32_t n = g.neighbours[i];
+                if(!visited[n]) {
+                    visited[n] = true;
+                    visit.push_back(n);
+                }
+            }
+            if(rcm) {
+                std::stable_sort(visit.begin() + first, visit.end(), [&g](uint32_t a, uint32_t b) {
+                    return g.degree(a) < g.degree(b);
+                });
+            }
+        }
+    }
+    if(rcm) {
+        std::reverse(visit.begin(), visit.end());
+    }
+    std::vector<state*> result;
+    result.reserve(states.size());
+    for(uint32_t s : visit) {
+        result.push_back(states[s]);
+    }
+    return result;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_STATE_ORDER_HPP
+#define MARL_STATE_ORDER_HPP
+
+#include <vector>
+
+namespace marl {
+
+class state;
+
+// Order in which states are laid out in the Q-Table and compiled environment
+enum class state_order_t {
+    environment,    // As loaded, i.e. as numbered in the problem file
+    bfs,            // Breadth-first over the transition graph
+    rcm             // Reverse Cuthill-McKee over the transition graph
+};
+
+/*
+ * Permutes states so that those connected by transitions, in either
+ * direction, are close to each other. Breadth-first search from each not yet
+ * visited state, in the order of the environment, puts the neighbours of a
+ * state next to each other. Reverse Cuthill-McKee starts each component at a
+ * state of lowest degree, visits neighbours by increasing degree and reverses
+ * the result, which keeps the bandwidth of the transition graph small.
+ * Transitions to states not in states are ignored. Only the layout changes,
+ * states keep their ids.
+ */
+std::vector<state*> order_states(const std::vector<state*>& states, state_order_t order);
+
+}
+
+#endif // MARL_STATE_ORDER_HPP
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs the learning step of agent.cpp with every exploration strategy, on
+ * dense and sparse tables and a compact storage, in a build with
+ * MARL_COUNT_ALLOCATIONS. Past the first episode, steps which do not add a
+ * row to the table run under no_allocations like the agent's, which asserts
+ * they make no heap allocation. They are counted here too, so the test also
+ * fails when built with NDEBUG. Steps also publish snapshots of the table,
+ * as in multi-agent mode, which may only allocate for rows added since the
+ * snapshot being refilled was last copied. The last snapshot must read like
+ * the table.
+ *
+ * The first episode starts next to the goal, so later ones reach rows the
+ * strategies have not seen yet.
+ */
+
+#include "../allocation-count.hpp"
+#include "../compiled-mdp.hpp"
+#include "../exploration.hpp"
+#include "../q-snapshot.hpp"
+#include "../q-table.hpp"
+#include "../random.hpp"
+#include "problem.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint32_t states = 256;
+const uint32_t episodes = 100;
+const size_t publish_interval = 64;
+
+marl::exploration_config make_config(marl::exploration_t strategy) {
+    marl::exploration_config config;
+    config.strategy = strategy;
+    config.annealing = marl::annealing_t::linear;
+    config.sampler = marl::softmax_sampler_t::inverse_cdf;
+    config.temperature = 1.0f;
+    config.min_temperature = 0.1f;
+    config.epsilon = 0.1f;
+    config.ucb_c = 1.0f;
+    config.episodes = episodes;
+    return config;
+}
+
+template<typename Exploration>
+bool allocation_free(marl::exploration_t strategy, marl::q_layout_t layout,
+                     marl::q_storage_t storage, const char* name) {
+    const marl::test_chain problem{states};
+    marl::compiled_mdp mdp;
+    mdp.compile(problem.states());
+    marl::q_table table;
+    table.initialize(problem.states(), layout, storage);
+    table.set_concurrent(false);
+    Exploration exploration(make_config(strategy), 2);
+    exploration.reserve_rows(mdp.states(), mdp.action_count());
+    std::vector<float> scratch(2);
+    marl::xoshiro256 engine{1};
+    // Publishing refills the snapshot of two publishes ago
+    marl::q_publisher publisher;
+    size_t published_rows[2] = {table.rows(), table.rows()};
+    publisher.publish(table);
+    publisher.publish(table);
+    uint32_t current = 1;
+    uint32_t episode = 1;
+    size_t steps = 0;
+    size_t allocating = 0;
+    while(episode < episodes) {
+        const uint64_t before = marl::thread_allocations();
+        bool armed = episode > 1;
+        bool goal = false;
+        {
+            marl::no_allocations guard(armed);
+            marl::q_row row = table.row(mdp.id(current));
+            if(row.index == marl::q_table::npos) {
+                row = table.materialize(mdp.state_at(current));
+                guard.disarm();
+                armed = false;
+            }
+            const float* values = table.values(row, scratch.data());
+            const size_t n = exploration.select(row, values, engine);
+            exploration.update(row, n);
+            const uint32_t t = mdp.sample_transition(mdp.first_action(current)
+                                                     + static_cast<uint32_t>(n), engine);
+            current = mdp.target(t);
+            const float max_q = std::max(0.0f, table.row_max(table.row(mdp.id(current))));
+            const uint32_t item = row.offset + static_cast<uint32_t>(n);
+            table.set_entry(row, n, 0.9f * table.value(item)
+                            + 0.1f * (mdp.reward(t) + 0.9f * max_q),
+                            table.confidence(item) + 0.001f);
+            goal = mdp.reward(t) == 1.0f;
+            if(steps % publish_interval == 0) {
+                if(table.rows() != published_rows[0]) {
+                    guard.disarm();
+                    armed = false;
+                }
+                publisher.publish(table);
+                published_rows[0] = published_rows[1];
+                published_rows[1] = table.rows();
+            }
+        }
+        if(armed && marl::thread_allocations() != before) {
+            ++allocating;
+        }
+        ++steps;
+        if(goal) {
+            exploration.end_episode(episode++);
+            current = static_cast<uint32_t>(marl::uniform_index(engine, mdp.states()));
+        }
+    }
+    publisher.publish(table);
+    std::vector<marl::q_entry_t> published;
+    std::vector<marl::q_entry_t> live;
+    size_t differing = 0;
+    for(uint32_t s = 0; s < states; ++s) {
+        publisher.current()->read_row(s, published);
+        table.read_row(s, live);
+        bool same = published.size() == live.size();
+        for(size_t i = 0; same && i < live.size(); ++i) {
+            same = published[i].action == live[i].action && published[i].value == live[i].value;
+        }
+        differing += same ? 0 : 1;
+    }
+    std::cout << name << ": " << allocating << " of " << steps
+              << " steps allocated past the first episode, " << differing
+              << " rows of the snapshot differ\n";
+    return allocating == 0 && differing == 0;
+}
+
+bool all_layouts(marl::exploration_t strategy, const char* name) {
+    bool passed = true;
+    const struct {
+        marl::q_layout_t layout;
+        marl::q_storage_t storage;
+        const char* name;
+    } tables[] = {
+        {marl::q_layout_t::dense, marl::q_storage_t::fp32, "dense fp32"},
+        {marl::q_layout_t::dense, marl::q_storage_t::int8, "dense int8"},
+        {marl::q_layout_t::sparse, marl::q_storage_t::fp32, "sparse fp32"},
+        {marl::q_layout_t::sparse, marl::q_storage_t::fp16, "sparse fp16"}
+    };
+    for(const auto& t : tables) {
+        const std::string label = std::string(name) + ", " + t.name;
+        switch(strategy) {
+            case marl::exploration_t::softmax:
+                passed = allocation_free<marl::softmax_exploration>(
+                             strategy, t.layout, t.storage, label.c_str()) && passed;
+                break;
+            case marl::exploration_t::epsilon_greedy:
+                passed = allocation_free<marl::epsilon_greedy_exploration>(
+                             strategy, t.layout, t.storage, label.c_str()) && passed;
+                break;
+            case marl::exploration_t::ucb1:
+                passed = allocation_free<marl::ucb1_exploration>(
+                             strategy, t.layout, t.storage, label.c_str()) && passed;
+                break;
+        }
+    }
+    return passed;
+}
+
+}
+
+int main() {
+    bool passed = all_layouts(marl::exploration_t::softmax, "softmax");
+    passed = all_layouts(marl::exploration_t::epsilon_greedy, "epsilon-greedy") && passed;
+    passed = all_layouts(marl::exploration_t::ucb1, "UCB1") && passed;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
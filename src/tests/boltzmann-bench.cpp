@@ -0,0 +1,149 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares boltzmann_d() against the implementation it replaced, which is
+ * kept below: draw frequencies must match, a large Q / tau must still pick
+ * the best action, and the time per draw is printed for a few row widths.
+ */
+
+#include "../exploration.hpp"
+#include "../random.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+// The former agent::boltzmann_d(), without its logging
+size_t legacy_boltzmann_d(const std::vector<float>& values, float temperature,
+                          std::mt19937& engine) {
+    static std::uniform_real_distribution<> dist(0, 1);
+    std::vector<float> probabilites;
+    float total = 0.0;
+    for(float value : values) {
+        total += exp(value / temperature);
+    }
+    for(float value : values) {
+        const float p = exp(value / temperature) / total;
+        probabilites.push_back(p);
+    }
+    float rand = dist(engine);
+    float max_p = 0;
+    size_t selected = 0;
+    for(float value : probabilites) {
+        max_p += value;
+        if(rand <= max_p) {
+            break;
+        } else {
+            selected++;
+        }
+    }
+    return selected;
+}
+
+const float temperature = 0.5f;
+const size_t draws = 200000;
+// Keeps the benchmarked draws from being optimized away
+volatile size_t selection;
+
+std::vector<float> make_row(size_t width) {
+    std::vector<float> values(width);
+    for(size_t i = 0; i < width; ++i) {
+        values[i] = std::sin(static_cast<float>(i)) * 2.0f;
+    }
+    return values;
+}
+
+// Largest difference of the selection frequencies of both implementations
+float frequency_difference(size_t width) {
+    const std::vector<float> values = make_row(width);
+    const marl::row_kernels& kernels = marl::row_kernels_for(width);
+    std::vector<float> weights(width);
+    std::vector<size_t> current(width);
+    std::vector<size_t> legacy(width);
+    marl::xoshiro256 engine{1};
+    std::mt19937 legacy_engine{1};
+    for(size_t i = 0; i < draws; ++i) {
+        ++current[marl::boltzmann_d(kernels, values.data(), width, temperature,
+                                    marl::softmax_sampler_t::inverse_cdf,
+                                    weights.data(), engine)];
+        ++legacy[std::min(legacy_boltzmann_d(values, temperature, legacy_engine), width - 1)];
+    }
+    float difference = 0.0f;
+    for(size_t i = 0; i < width; ++i) {
+        difference = std::max(difference, std::fabs(static_cast<float>(current[i])
+                                                     - static_cast<float>(legacy[i])) / draws);
+    }
+    return difference;
+}
+
+void benchmark(size_t width) {
+    const std::vector<float> values = make_row(width);
+    const marl::row_kernels& kernels = marl::row_kernels_for(width);
+    std::vector<float> weights(width);
+    marl::xoshiro256 engine{2};
+    std::mt19937 legacy_engine{2};
+    const size_t n = draws * 4 / width + 1000;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        selection = legacy_boltzmann_d(values, temperature, legacy_engine);
+    }
+    const double legacy = std::chrono::duration<double, std::nano>(
+                              std::chrono::steady_clock::now() - start).count() / n;
+    start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        selection = marl::boltzmann_d(kernels, values.data(), width, temperature,
+                                  marl::softmax_sampler_t::inverse_cdf, weights.data(), engine);
+    }
+    const double current = std::chrono::duration<double, std::nano>(
+                               std::chrono::steady_clock::now() - start).count() / n;
+    std::cout << width << " actions: " << legacy << " ns before, " << current
+              << " ns now per draw\n";
+}
+
+}
+
+int main() {
+    bool passed = true;
+    for(size_t width : {4, 64, 512}) {
+        const float difference = frequency_difference(width);
+        std::cout << width << " actions: frequencies differ by at most " << difference << '\n';
+        passed = passed && difference < 0.01f;
+    }
+    // exp(1000 / 0.01) overflowed before, the best action has all the mass
+    const std::vector<float> large{1000.0f, 999.0f, 998.0f};
+    std::vector<float> weights(large.size());
+    marl::xoshiro256 engine{3};
+    const size_t selected = marl::boltzmann_d(marl::row_kernels_for(large.size()), large.data(),
+                                              large.size(), 0.01f,
+                                              marl::softmax_sampler_t::inverse_cdf,
+                                              weights.data(), engine);
+    std::cout << "Q / tau of 1e5: selected " << selected << '\n';
+    passed = passed && selected == 0;
+    for(size_t width : {4, 64, 512}) {
+        benchmark(width);
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Learners add 0.001 to the confidence of a slot on every visit. On compact
+ * storage those increments must still add up, which they only do while
+ * confidences are kept as fp32. Also checks that the storage report sees
+ * what encoding confidences like the values would lose. Round trips of the
+ * values themselves are checked by value-storage.
+ */
+
+#include "../q-table.hpp"
+#include "problem.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+const size_t visits = 10000;
+
+bool accumulate(marl::q_storage_t storage, const char* name) {
+    const marl::test_problem problem{16, 4};
+    marl::q_table table;
+    table.initialize(problem.states(), marl::q_layout_t::dense, storage);
+    // Values of different magnitudes, so int8 blocks get a coarse scale
+    for(size_t r = 0; r < table.rows(); ++r) {
+        const marl::q_row row = table.row_at(r);
+        for(size_t n = 0; n < row.size(); ++n) {
+            table.set_value(row, n, static_cast<float>(r * row.size() + n) * 10.0f);
+        }
+    }
+    const marl::q_row row = table.row_at(3);
+    for(size_t i = 0; i < visits; ++i) {
+        table.set_confidence(row.offset + 1, table.confidence(row.offset + 1) + 0.001f);
+    }
+    const float expected = visits * 0.001f;
+    const float confidence = table.confidence(row.offset + 1);
+    const marl::q_storage_stats stats = table.evaluate(storage);
+    std::cout << name << ": confidence " << confidence << " after " << visits
+              << " visits, " << stats.max_confidence_error
+              << " max error if stored as " << name << '\n';
+    const bool reported = storage == marl::q_storage_t::fp32 ?
+                          stats.max_confidence_error == 0.0f : stats.max_confidence_error > 0.0f;
+    return std::fabs(confidence - expected) < expected * 0.01f && reported;
+}
+
+}
+
+int main() {
+    bool passed = accumulate(marl::q_storage_t::fp32, "fp32");
+    passed = accumulate(marl::q_storage_t::fp16, "fp16") && passed;
+    passed = accumulate(marl::q_storage_t::bf16, "bf16") && passed;
+    passed = accumulate(marl::q_storage_t::int8, "int8") && passed;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
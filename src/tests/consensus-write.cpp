@@ -0,0 +1,134 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * learn_multi() writes the consensus of its peers into the row of the
+ * current state with q_table::set_values(). It used to write it into every
+ * slot of the table whose action id appears in the consensus, which is kept
+ * below for comparison. Checks that no other row changes, on problems whose
+ * states share action ids, and prints the steps per second of both writes.
+ */
+
+#include "../q-table.hpp"
+#include "problem.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const uint32_t actions = 4;
+
+// The former write of learn_multi(), consensus holds a value per action of row
+void legacy_write(marl::q_table& table, const marl::q_row& row, const float* consensus) {
+    for(size_t r = 0; r < table.rows(); ++r) {
+        const marl::q_row target = table.row_at(r);
+        for(size_t n = 0; n < target.size(); ++n) {
+            for(size_t p = 0; p < row.size(); ++p) {
+                if(row.actions[p] == target.actions[n]) {
+                    table.set_value(target, n, consensus[p]);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void write(marl::q_table& table, const marl::q_row& row, const float* consensus) {
+    table.set_values(row, consensus);
+}
+
+// Slots outside the row whose value differs from before
+size_t changed_elsewhere(const marl::q_table& table, const marl::q_row& row,
+                         const std::vector<float>& before) {
+    size_t changed = 0;
+    for(uint32_t slot = 0; slot < table.size(); ++slot) {
+        const bool inside = slot >= row.offset && slot < row.offset + row.size();
+        if(!inside && table.value(slot) != before[slot]) {
+            ++changed;
+        }
+    }
+    return changed;
+}
+
+std::vector<float> snapshot(const marl::q_table& table) {
+    std::vector<float> values(table.size());
+    for(uint32_t slot = 0; slot < table.size(); ++slot) {
+        values[slot] = table.value(slot);
+    }
+    return values;
+}
+
+bool regression(uint32_t states) {
+    const marl::test_problem problem{states, actions, true};
+    marl::q_table table;
+    table.initialize(problem.states());
+    const marl::q_row row = table.row(states / 2);
+    const float consensus[actions] = {0.5f, -0.25f, 1.0f, 0.125f};
+    std::vector<float> before = snapshot(table);
+    table.set_values(row, consensus);
+    const size_t changed = changed_elsewhere(table, row, before);
+    bool written = true;
+    for(size_t n = 0; n < row.size(); ++n) {
+        written = written && table.value(row.offset + n) == consensus[n];
+    }
+    marl::q_table legacy;
+    legacy.initialize(problem.states());
+    before = snapshot(legacy);
+    legacy_write(legacy, legacy.row(states / 2), consensus);
+    std::cout << states << " states with shared action ids: " << changed
+              << " slots changed outside the row, "
+              << changed_elsewhere(legacy, legacy.row(states / 2), before) << " before\n";
+    return changed == 0 && written;
+}
+
+template<typename Write>
+double steps_per_second(uint32_t states, size_t steps, Write write) {
+    const marl::test_problem problem{states, actions};
+    marl::q_table table;
+    table.initialize(problem.states());
+    float consensus[actions] = {0.5f, -0.25f, 1.0f, 0.125f};
+    const auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < steps; ++i) {
+        consensus[i % actions] += 0.001f;
+        write(table, table.row(static_cast<uint32_t>(i % states)), consensus);
+    }
+    return steps / std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                 - start).count();
+}
+
+void benchmark(uint32_t states, size_t legacy_steps) {
+    const double current = steps_per_second(states, 1000000, write);
+    const double legacy = steps_per_second(states, legacy_steps, legacy_write);
+    std::cout << states << " states: " << current << " steps/s, " << legacy
+              << " steps/s before\n";
+}
+
+}
+
+int main() {
+    bool passed = regression(1000);
+    passed = regression(100000) && passed;
+    benchmark(1000, 2000);
+    benchmark(100000, 20);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks that the Gumbel-max sampler of boltzmann_d() and boltzmann_batch()
+ * draws from the same Boltzmann distribution as inverse CDF sampling: a
+ * chi-square test of the selection counts of each against the exact
+ * probabilities. Then prints the time per draw of both on wide rows.
+ */
+
+#include "../exploration.hpp"
+#include "../random.hpp"
+#include "problem.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const float temperature = 0.5f;
+const size_t draws = 200000;
+// Keeps the benchmarked draws from being optimized away
+volatile size_t selection;
+
+std::vector<float> make_row(size_t width) {
+    std::vector<float> values(width);
+    for(size_t i = 0; i < width; ++i) {
+        values[i] = std::sin(static_cast<float>(i)) * 2.0f;
+    }
+    return values;
+}
+
+// Upper 0.1% point of the chi-square distribution (Wilson-Hilferty)
+double chi_square_limit(size_t degrees) {
+    const double k = static_cast<double>(degrees);
+    const double c = 2.0 / (9.0 * k);
+    return k * std::pow(1.0 - c + 3.09 * std::sqrt(c), 3.0);
+}
+
+// Whether the selection counts fit the exact distribution of values
+bool fits(const std::vector<float>& values, const std::vector<size_t>& counts,
+          const char* name) {
+    const size_t width = values.size();
+    double total = 0.0;
+    std::vector<double> p(width);
+    for(size_t i = 0; i < width; ++i) {
+        p[i] = std::exp(static_cast<double>(values[i]) / temperature);
+        total += p[i];
+    }
+    // Actions expected fewer than 5 times are pooled into one bin
+    double statistic = 0.0;
+    size_t bins = 0;
+    double pooled_expected = 0.0;
+    double pooled_observed = 0.0;
+    for(size_t i = 0; i < width; ++i) {
+        const double expected = p[i] / total * draws;
+        if(expected < 5.0) {
+            pooled_expected += expected;
+            pooled_observed += counts[i];
+            continue;
+        }
+        statistic += (counts[i] - expected) * (counts[i] - expected) / expected;
+        ++bins;
+    }
+    if(pooled_expected > 0.0) {
+        statistic += (pooled_observed - pooled_expected) * (pooled_observed - pooled_expected)
+                     / pooled_expected;
+        ++bins;
+    }
+    const double limit = chi_square_limit(bins - 1);
+    std::cout << width << " actions, " << name << ": chi-square " << statistic << " over "
+              << bins - 1 << " degrees of freedom, limit " << limit << '\n';
+    return statistic < limit;
+}
+
+bool equivalent(size_t width, marl::softmax_sampler_t sampler, const char* name) {
+    const std::vector<float> values = make_row(width);
+    const marl::row_kernels& kernels = marl::row_kernels_for(width);
+    std::vector<float> weights(width);
+    std::vector<size_t> counts(width);
+    marl::xoshiro256 engine{1};
+    for(size_t i = 0; i < draws; ++i) {
+        ++counts[marl::boltzmann_d(kernels, values.data(), width, temperature, sampler,
+                                   weights.data(), engine)];
+    }
+    return fits(values, counts, name);
+}
+
+// Same for rows drawn by boltzmann_batch(), a batch of every state at a time
+bool batch_equivalent(uint32_t width, marl::softmax_sampler_t sampler, const char* name) {
+    const uint32_t states = 8;
+    const marl::test_problem problem{states, width};
+    marl::q_table table;
+    table.initialize(problem.states());
+    const std::vector<float> values = make_row(width);
+    std::vector<uint32_t> batch(states);
+    for(uint32_t s = 0; s < states; ++s) {
+        table.set_values(table.row(s), values.data());
+        batch[s] = s;
+    }
+    std::vector<uint32_t> selected(states);
+    std::vector<float> scratch;
+    std::vector<size_t> counts(width);
+    marl::xoshiro256 engine{3};
+    for(size_t i = 0; i < draws / states; ++i) {
+        marl::boltzmann_batch(table, batch.data(), states, temperature, sampler,
+                              selected.data(), scratch, engine);
+        for(uint32_t action : selected) {
+            ++counts[action];
+        }
+    }
+    return fits(values, counts, name);
+}
+
+double nanoseconds_per_draw(size_t width, marl::softmax_sampler_t sampler) {
+    const std::vector<float> values = make_row(width);
+    const marl::row_kernels& kernels = marl::row_kernels_for(width);
+    std::vector<float> weights(width);
+    marl::xoshiro256 engine{2};
+    const size_t n = draws * 16 / width + 1000;
+    const auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < n; ++i) {
+        selection = marl::boltzmann_d(kernels, values.data(), width, temperature, sampler,
+                                      weights.data(), engine);
+    }
+    return std::chrono::duration<double, std::nano>(
+               std::chrono::steady_clock::now() - start).count() / n;
+}
+
+}
+
+int main() {
+    bool passed = true;
+    for(size_t width : {4, 16, 256}) {
+        passed = equivalent(width, marl::softmax_sampler_t::inverse_cdf, "inverse CDF") && passed;
+        passed = equivalent(width, marl::softmax_sampler_t::gumbel, "Gumbel") && passed;
+    }
+    for(uint32_t width : {4, 16}) {
+        passed = batch_equivalent(width, marl::softmax_sampler_t::inverse_cdf,
+                                  "inverse CDF batch") && passed;
+        passed = batch_equivalent(width, marl::softmax_sampler_t::gumbel, "Gumbel batch")
+                 && passed;
+    }
+    for(size_t width : {64, 512, 4096}) {
+        std::cout << width << " actions: "
+                  << nanoseconds_per_draw(width, marl::softmax_sampler_t::inverse_cdf)
+                  << " ns inverse CDF, "
+                  << nanoseconds_per_draw(width, marl::softmax_sampler_t::gumbel)
+                  << " ns Gumbel per draw\n";
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
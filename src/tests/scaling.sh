@@ -0,0 +1,53 @@
+#!/bin/sh
+# Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+# Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+#
+# This file is part of marl_agent.
+#
+# marl_agent is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# marl_agent is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+
+# Measures how learning on several threads (-j) scales. Learns the problem
+# in MARL_PROBLEM for MARL_EPISODES episodes (10000 by default) on 1, 2, 4,
+# ... threads, up to MARL_MAX_THREADS or else the number of CPUs, and prints
+# the wall-clock time and speedup of each run. No problem ships with the
+# sources, so the test is skipped unless one is given:
+#
+#   MARL_PROBLEM=grid.mdpx make check
+
+if test -z "$MARL_PROBLEM"; then
+    echo "MARL_PROBLEM is not set, skipping"
+    exit 77
+fi
+episodes=${MARL_EPISODES:-10000}
+max=${MARL_MAX_THREADS:-`getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1`}
+output=`mktemp -d` || exit 1
+trap 'rm -rf "$output"' EXIT
+
+now() {
+    date +%s.%N
+}
+
+threads=1
+base=
+while test $threads -le $max; do
+    start=`now`
+    ./marl-agent -m single -l learn -p "$MARL_PROBLEM" -s 0 -n $episodes -z 1 -v 0 \
+        -j $threads -o "$output/q" -x "$output/stats" || exit 1
+    end=`now`
+    seconds=`echo "$start $end" | awk '{ printf "%.3f", $2 - $1 }'`
+    test -n "$base" || base=$seconds
+    echo "$threads $seconds $base" | awk \
+        '{ printf "%d threads: %.3f s, speedup %.2f\n", $1, $2, $3 / $2 }'
+    threads=`expr $threads \* 2`
+done
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs the learner's writes and peers' reads of a Q-Table on separate threads
+ * at full rate, as learn_multi() and process_request() do. Every write stores
+ * the same number as value and confidence of a slot, so a reader that sees
+ * them differ has read a torn entry. On sparse layout the writer also appends
+ * rows while readers are reading, which moves the columns.
+ */
+
+#include "../q-table.hpp"
+#include "../random.hpp"
+#include "problem.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const uint32_t states = 4096;
+const uint32_t actions = 4;
+const size_t readers = 3;
+const std::chrono::milliseconds duration{500};
+
+struct counters {
+    std::atomic<uint64_t> writes{0};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> torn{0};
+};
+
+void write(marl::q_table& table, const marl::test_problem& problem,
+           const std::atomic<bool>& done, counters& count) {
+    marl::xoshiro256 engine{1};
+    uint64_t writes = 0;
+    // Exactly representable, so storing it as value and confidence is lossless
+    float number = 0.0f;
+    while(!done.load(std::memory_order_relaxed)) {
+        const marl::state* s = problem.states()[engine() % states];
+        const marl::q_row row = table.materialize(s);
+        number = number < 1048576.0f ? number + 1.0f : 0.0f;
+        table.set_entry(row, engine() % row.size(), number, number);
+        ++writes;
+    }
+    count.writes += writes;
+}
+
+void read(const marl::q_table& table, size_t id, const std::atomic<bool>& done,
+          counters& count) {
+    marl::xoshiro256 engine{2, id};
+    std::vector<marl::q_entry_t> row;
+    uint64_t reads = 0;
+    uint64_t torn = 0;
+    while(!done.load(std::memory_order_relaxed)) {
+        table.read_row(static_cast<uint32_t>(engine() % states), row);
+        for(const marl::q_entry_t& e : row) {
+            if(e.value != e.confidence) {
+                ++torn;
+            }
+        }
+        ++reads;
+    }
+    count.reads += reads;
+    count.torn += torn;
+}
+
+bool stress(marl::q_layout_t layout, const char* name) {
+    const marl::test_problem problem{states, actions};
+    marl::q_table table;
+    table.initialize(problem.states(), layout);
+    std::atomic<bool> done{false};
+    counters count;
+    std::vector<std::thread> threads;
+    threads.emplace_back(write, std::ref(table), std::cref(problem), std::cref(done),
+                         std::ref(count));
+    for(size_t i = 0; i < readers; ++i) {
+        threads.emplace_back(read, std::cref(table), i, std::cref(done), std::ref(count));
+    }
+    std::this_thread::sleep_for(duration);
+    done = true;
+    for(std::thread& t : threads) {
+        t.join();
+    }
+    const double seconds = std::chrono::duration<double>(duration).count();
+    std::cout << name << ": " << count.writes / seconds << " writes/s, "
+              << count.reads / seconds << " row reads/s, "
+              << count.torn << " torn entries\n";
+    return count.torn == 0;
+}
+
+}
+
+int main() {
+    bool passed = stress(marl::q_layout_t::dense, "dense");
+    passed = stress(marl::q_layout_t::sparse, "sparse") && passed;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
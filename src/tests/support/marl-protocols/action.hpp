@@ -0,0 +1,76 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_TESTS_ACTION_HPP
+#define MARL_TESTS_ACTION_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace marl {
+
+class state;
+
+// Stand-in for the transition of marl-protocols, see state.hpp
+class transition {
+public:
+    transition(state* to, float reward, float probability):
+        m_to{to},
+        m_reward{reward},
+        m_probability{probability} {
+    }
+    state* to() const {
+        return m_to;
+    }
+    float reward() const {
+        return m_reward;
+    }
+    float probability() const {
+        return m_probability;
+    }
+private:
+    state* m_to;
+    float m_reward;
+    float m_probability;
+};
+
+// Stand-in for the action of marl-protocols, see state.hpp
+class action {
+public:
+    explicit action(uint32_t id):
+        m_id{id} {
+    }
+    uint32_t id() const {
+        return m_id;
+    }
+    const std::vector<transition*>& transitions() const {
+        return m_transitions;
+    }
+    void add_transition(transition* t) {
+        m_transitions.push_back(t);
+    }
+private:
+    uint32_t m_id;
+    std::vector<transition*> m_transitions;
+};
+
+}
+
+#endif // MARL_TESTS_ACTION_HPP
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_TESTS_STATE_HPP
+#define MARL_TESTS_STATE_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace marl {
+
+class action;
+
+/*
+ * Stand-in for the state of marl-protocols, so tests can build the modules
+ * they exercise without the library. Only has what those modules use: the
+ * id and the actions leaving the state, which the test owns.
+ */
+class state {
+public:
+    explicit state(uint32_t id):
+        m_id{id} {
+    }
+    uint32_t id() const {
+        return m_id;
+    }
+    const std::vector<action*>& actions() const {
+        return m_actions;
+    }
+    void add_action(action* a) {
+        m_actions.push_back(a);
+    }
+private:
+    uint32_t m_id;
+    std::vector<action*> m_actions;
+};
+
+}
+
+#endif // MARL_TESTS_STATE_HPP
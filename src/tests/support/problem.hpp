@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MARL_TESTS_PROBLEM_HPP
+#define MARL_TESTS_PROBLEM_HPP
+
+#include <marl-protocols/state.hpp>
+#include <marl-protocols/action.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace marl {
+
+/*
+ * Problem of a given number of states with the same number of actions each,
+ * for building Q-Tables in tests. Action ids are unique, or repeat in every
+ * state when shared, which is how problems reusing "up", "down", ... look.
+ */
+class test_problem {
+public:
+    test_problem(uint32_t states, uint32_t actions, bool shared_ids = false) {
+        for(uint32_t s = 0; s < states; ++s) {
+            m_owned_states.emplace_back(new state{s});
+            state* current = m_owned_states.back().get();
+            for(uint32_t a = 0; a < actions; ++a) {
+                m_owned_actions.emplace_back(new action{shared_ids ? a : s * actions + a});
+                current->add_action(m_owned_actions.back().get());
+            }
+            m_states.push_back(current);
+        }
+    }
+    const std::vector<state*>& states() const {
+        return m_states;
+    }
+private:
+    std::vector<std::unique_ptr<state>> m_owned_states;
+    std::vector<std::unique_ptr<action>> m_owned_actions;
+    std::vector<state*> m_states;
+};
+
+/*
+ * Chain of states with a move to either neighbour, for running learning
+ * loops in tests. Moving into state 0 pays 1, as reaching a goal, the ends
+ * of the chain move into themselves.
+ */
+class test_chain {
+public:
+    explicit test_chain(uint32_t states) {
+        for(uint32_t s = 0; s < states; ++s) {
+            m_owned_states.emplace_back(new state{s});
+            m_states.push_back(m_owned_states.back().get());
+        }
+        for(uint32_t s = 0; s < states; ++s) {
+            const uint32_t targets[] = {s > 0 ? s - 1 : 0, s + 1 < states ? s + 1 : s};
+            for(uint32_t a = 0; a < 2; ++a) {
+                m_owned_transitions.emplace_back(
+                    new transition{m_states[targets[a]], targets[a] == 0 ? 1.0f : 0.0f, 1.0f});
+                m_owned_actions.emplace_back(new action{2 * s + a});
+                m_owned_actions.back()->add_transition(m_owned_transitions.back().get());
+                m_states[s]->add_action(m_owned_actions.back().get());
+            }
+        }
+    }
+    const std::vector<state*>& states() const {
+        return m_states;
+    }
+private:
+    std::vector<std::unique_ptr<state>> m_owned_states;
+    std::vector<std::unique_ptr<action>> m_owned_actions;
+    std::vector<std::unique_ptr<transition>> m_owned_transitions;
+    std::vector<state*> m_states;
+};
+
+}
+
+#endif // MARL_TESTS_PROBLEM_HPP
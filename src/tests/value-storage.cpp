@@ -0,0 +1,249 @@
+/*
+ * Copyright 2017 - Roya Ghasemzade <roya@ametisco.ir>
+ * Copyright 2017 - Soroush Rabiei <soroush@ametisco.ir>
+ *
+ * This file is part of marl_agent.
+ *
+ * marl_agent is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * marl_agent is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with marl_agent.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Round trips values through every encoding of a Q-Table column and checks
+ * the error stays within what the encoding promises: none on fp32, half a
+ * unit in the last place on fp16 and bf16, half a step of the block's scale
+ * on int8. Then checks that int8 blocks rescale when a larger value is
+ * written, and that the cached maximum and greedy action of every row still
+ * match its values after writes requantized their block.
+ */
+
+#include "../exploration.hpp"
+#include "../q-storage.hpp"
+#include "../q-table.hpp"
+#include "../random.hpp"
+#include "problem.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace {
+
+const size_t values = 4096;
+
+// Magnitudes spread over [10^low, 10^high), either sign
+std::vector<float> make_values(size_t n, float low, float high, uint64_t seed) {
+    marl::xoshiro256 engine{seed};
+    std::vector<float> out(n);
+    for(float& v : out) {
+        const float magnitude = std::pow(10.0f, low + (high - low) * marl::uniform01(engine));
+        v = marl::uniform01(engine) < 0.5f ? -magnitude : magnitude;
+    }
+    return out;
+}
+
+// Largest error of the column against what was written, relative to bound()
+template<typename Bound>
+float worst(const marl::q_column& column, const std::vector<float>& written, Bound bound) {
+    float ratio = 0.0f;
+    for(size_t i = 0; i < written.size(); ++i) {
+        const float error = std::fabs(column.get(i) - written[i]);
+        const float limit = bound(i);
+        if(limit == 0.0f) {
+            ratio = std::max(ratio, error == 0.0f ? 0.0f : std::numeric_limits<float>::infinity());
+        } else {
+            ratio = std::max(ratio, error / limit);
+        }
+    }
+    return ratio;
+}
+
+bool report(const char* name, float ratio) {
+    std::cout << name << ": worst error " << ratio << " of its bound\n";
+    return ratio <= 1.0f;
+}
+
+bool round_trip_floats() {
+    bool passed = true;
+    // Normal halves cover [2^-14, 65504], below that the step is fixed
+    const std::vector<float> halves = make_values(values, -7.0f, 4.8f, 1);
+    const std::vector<float> singles = make_values(values, -30.0f, 30.0f, 2);
+    const struct {
+        marl::q_storage_t storage;
+        const std::vector<float>& written;
+        const char* name;
+    } cases[] = {
+        {marl::q_storage_t::fp32, singles, "fp32"},
+        {marl::q_storage_t::fp16, halves, "fp16"},
+        {marl::q_storage_t::bf16, singles, "bf16"}
+    };
+    for(const auto& c : cases) {
+        marl::q_column column;
+        column.reset(c.storage);
+        column.resize(c.written.size());
+        for(size_t i = 0; i < c.written.size(); ++i) {
+            passed = !column.set(i, c.written[i]) && passed;
+        }
+        const std::vector<float>& written = c.written;
+        passed = report(c.name, worst(column, written, [&](size_t i) {
+            const float magnitude = std::fabs(written[i]);
+            switch(c.storage) {
+                case marl::q_storage_t::fp16:
+                    return std::max(magnitude, std::ldexp(1.0f, -14)) * std::ldexp(1.0f, -11);
+                case marl::q_storage_t::bf16:
+                    return magnitude * std::ldexp(1.0f, -8);
+                default:
+                    return 0.0f;
+            }
+        })) && passed;
+    }
+    // Out of range halves saturate to infinity instead of wrapping
+    marl::q_column column;
+    column.reset(marl::q_storage_t::fp16);
+    column.resize(2);
+    column.set(0, 1.0e5f);
+    column.set(1, -1.0e5f);
+    const bool saturated = std::isinf(column.get(0)) && column.get(0) > 0.0f
+                           && std::isinf(column.get(1)) && column.get(1) < 0.0f;
+    std::cout << "fp16 out of range: " << column.get(0) << ", " << column.get(1) << '\n';
+    return saturated && passed;
+}
+
+// Largest magnitude written into the int8 block of each slot
+std::vector<float> block_maxima(const std::vector<float>& written) {
+    const size_t block = marl::q_column::int8_block;
+    std::vector<float> out(written.size());
+    for(size_t first = 0; first < written.size(); first += block) {
+        float m = 0.0f;
+        for(size_t i = first; i < std::min(first + block, written.size()); ++i) {
+            m = std::max(m, std::fabs(written[i]));
+        }
+        for(size_t i = first; i < std::min(first + block, written.size()); ++i) {
+            out[i] = m;
+        }
+    }
+    return out;
+}
+
+bool round_trip_int8() {
+    // A block's scale is 1.25 / 127 of the magnitude that last grew it
+    const float step = 1.25f / 127.0f;
+    bool passed = true;
+    // Blocks of values of a similar magnitude, largest one written first so
+    // every block is scaled once
+    std::vector<float> written = make_values(values, -2.0f, 3.0f, 3);
+    for(size_t first = 0; first < values; first += marl::q_column::int8_block) {
+        for(size_t i = first + 1; i < first + marl::q_column::int8_block; ++i) {
+            written[i] = written[first] * (static_cast<float>(i - first) / 17.0f);
+        }
+    }
+    const std::vector<float> maxima = block_maxima(written);
+    marl::q_column column;
+    column.reset(marl::q_storage_t::int8);
+    column.resize(values);
+    size_t rescales = 0;
+    for(size_t i = 0; i < values; ++i) {
+        rescales += column.set(i, written[i]) ? 1 : 0;
+    }
+    passed = rescales == values / marl::q_column::int8_block && passed;
+    passed = report("int8", worst(column, written, [&](size_t i) {
+        return maxima[i] * step / 2.0f;
+    })) && passed;
+    // Small values first, then one which does not fit the block's scale:
+    // only that write rescales, the small values are requantized once more
+    // and the next block is left alone
+    const size_t block = marl::q_column::int8_block;
+    std::vector<float> small(2 * block);
+    for(size_t i = 0; i < small.size(); ++i) {
+        small[i] = 0.01f * static_cast<float>(i + 1);
+    }
+    column.reset(marl::q_storage_t::int8);
+    column.resize(small.size());
+    for(size_t i = 0; i < small.size(); ++i) {
+        column.set(i, small[i]);
+    }
+    std::vector<float> before(small.size());
+    for(size_t i = 0; i < small.size(); ++i) {
+        before[i] = column.get(i);
+    }
+    const bool grew = column.set(3, 100.0f);
+    small[3] = 100.0f;
+    const bool kept = !column.set(4, 50.0f);
+    small[4] = 50.0f;
+    bool untouched = true;
+    for(size_t i = block; i < small.size(); ++i) {
+        untouched = untouched && column.get(i) == before[i];
+    }
+    const float ratio = worst(column, std::vector<float>(small.begin(), small.begin() + block),
+                              [&](size_t) {
+        return 100.0f * step;
+    });
+    std::cout << "int8 rescale: " << (grew ? "grew" : "did not grow") << ", "
+              << (kept ? "kept" : "rescaled again") << " for a smaller value, next block "
+              << (untouched ? "untouched" : "changed") << ", worst error " << ratio
+              << " of a step\n";
+    return grew && kept && untouched && ratio <= 1.0f && passed;
+}
+
+// Whether the cached maximum and greedy action of every row match its values
+size_t stale_rows(const marl::q_table& table) {
+    std::vector<float> scratch(table.size());
+    size_t stale = 0;
+    for(size_t r = 0; r < table.rows(); ++r) {
+        const marl::q_row row = table.row_at(r);
+        const float* v = table.values(row, scratch.data());
+        size_t best = 0;
+        for(size_t n = 1; n < row.size(); ++n) {
+            if(v[n] > v[best]) {
+                best = n;
+            }
+        }
+        if(table.row_max(row) != v[best] || table.row_argmax(row) != best) {
+            ++stale;
+        }
+    }
+    return stale;
+}
+
+bool cached_maxima(marl::q_storage_t storage, const char* name) {
+    // Rows of 5 actions straddle the int8 blocks of 16 slots
+    const marl::test_problem problem{64, 5};
+    marl::q_table table;
+    table.initialize(problem.states(), marl::q_layout_t::dense, storage);
+    table.set_concurrent(false);
+    const std::vector<float> written = make_values(20000, -3.0f, 3.0f, 4);
+    marl::xoshiro256 engine{5};
+    size_t stale = 0;
+    for(float v : written) {
+        const marl::q_row row = table.row_at(marl::uniform_index(engine, table.rows()));
+        table.set_entry(row, marl::uniform_index(engine, row.size()), v, 1.0f);
+        stale += stale_rows(table);
+    }
+    std::cout << name << " table: " << stale << " stale row maxima over "
+              << written.size() << " writes\n";
+    return stale == 0;
+}
+
+}
+
+int main() {
+    bool passed = round_trip_floats();
+    passed = round_trip_int8() && passed;
+    passed = cached_maxima(marl::q_storage_t::fp32, "fp32") && passed;
+    passed = cached_maxima(marl::q_storage_t::fp16, "fp16") && passed;
+    passed = cached_maxima(marl::q_storage_t::bf16, "bf16") && passed;
+    passed = cached_maxima(marl::q_storage_t::int8, "int8") && passed;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}